@@ -21,6 +21,7 @@ class App {
   float fov;           // has to be larger than 0, where larger values mean a smaller FOV
   std::chrono::system_clock::time_point curTime;
   double deltaElapsedTime; // elapsed time between each frame in ms
+  double targetFrameTime;  // the frame time in s the samples per frame are adapted to
   Camera camera;
   bool quit;
 
@@ -53,8 +54,10 @@ public:
   /**
    * the app has to be initialized after SDL 2 is completely intialized, that includes the creation
    * of an opengl context
+   *
+   * @param scene the scene that is displayed first
    */
-  App(SDL_Window *window);
+  App(SDL_Window *window, const SceneVariant &scene);
 
   ~App();
 
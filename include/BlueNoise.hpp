@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bluenoise {
+/**
+ * generates a tileable blue noise texture with the void and cluster method (Ulichney 1993), the
+ * values are the ranks of the pixels mapped to [0, 1), so they are uniformly distributed and the
+ * pixels with similar values are spread evenly over the tile
+ *
+ * @param size the width and height of the tile
+ * @param seed the seed of the initial random pattern
+ */
+extern std::vector<float> generate(size_t size, uint32_t seed = 0);
+} // namespace bluenoise
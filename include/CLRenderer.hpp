@@ -0,0 +1,576 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+
+#include "DistanceField.hpp"
+#include "ProgramCache.hpp"
+#include "Renderer.hpp"
+#include "SceneParams.hpp"
+#include "WorkGroupTuner.hpp"
+#include <CL/cl.hpp>
+#include <atomic>
+#include <future>
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef struct { cl_float4 m[3]; } cl_float3x4; // for the view matrix
+
+/**
+ * the header of a checkpoint file, it is followed by the raw image and the moments of all pixels
+ */
+struct CheckpointHeader {
+  char magic[8];       // "PMCLCKP2"
+  cl_uint width;       // the render size of the checkpoint
+  cl_uint height;
+  cl_int sampleCount;  // the count of samples per pixel of all completed passes
+  cl_uint sampleIndex; // the index of the next sample for the random number generator
+  cl_float fov;
+  cl_float3x4 vMatrix;
+};
+
+/**
+ * renders with a plain opencl context into ordinary opencl memory objects, no opengl context is
+ * needed, so it can be used on machines without a windowing system (e.g. with a CPU ICD like pocl)
+ */
+class CLRenderer : public Renderer {
+public:
+  /**
+   * an image which is read back asynchronously into a pinned host buffer (CL_MEM_ALLOC_HOST_PTR),
+   * the buffer stays mapped until 'release' is called, afterwards the renderer reuses it
+   */
+  class PinnedImage {
+    friend class CLRenderer;
+
+    cl::CommandQueue queue;  // the queue the buffer is mapped and unmapped with
+    cl::Buffer buffer;       // the pinned buffer, it is reused by the following readbacks
+    size_t capacity;         // the size of 'buffer' in bytes
+    void *pixels;            // the mapped buffer, nullptr if it isn't mapped
+    std::atomic<bool> inUse; // the buffer is mapped or will be mapped
+    cl::Event ready;         // is complete as soon as the buffer is mapped
+    size_t width;
+    size_t height;
+    bool hdr;
+
+    PinnedImage(const cl::CommandQueue &queue);
+
+  public:
+    ~PinnedImage();
+
+    size_t getWidth() const;
+
+    size_t getHeight() const;
+
+    /**
+     * returns true if the pixels are the raw accumulation (RGBA with 32 bit floats, each pixel
+     * has to be divided by its alpha component), otherwise they are tonemapped (RGBA with 8 bit)
+     */
+    bool isHDR() const;
+
+    /**
+     * blocks until the readback is complete and returns the pixels
+     */
+    const void *getPixels();
+
+    /**
+     * unmaps the buffer, so the renderer can reuse it, the pixels must not be accessed afterwards
+     */
+    void release();
+  };
+
+protected:
+  /**
+   * the resources of a frame, which have to stay untouched as long as the frame is in flight
+   */
+  struct FrameResources {
+    cl_float3x4 vMatrix;      // host copy of the view matrix, which is uploaded asynchronously
+    cl::Buffer vMatrixBuffer; // the view matrix of this frame
+    cl::Event done;           // is complete as soon as the frame is rendered
+  };
+
+  /**
+   * the kernels of the wavefront mode, one kernel per stage of a path (see kernels/render.cl)
+   */
+  struct WavefrontKernels {
+    cl::make_kernel<cl::Buffer &, cl_uint, cl_uint, cl_uint, const cl::Buffer &,
+                    const cl::Buffer &, const cl::Buffer &, cl_int, cl_int, cl_float, cl_uint,
+                    cl_uint, const cl::Buffer &, cl_int, const cl::Buffer &, cl_int>
+        generate;
+    cl::make_kernel<cl::Buffer &, cl::Buffer &, cl::Buffer &, cl_uint, const cl::Buffer &,
+                    const cl::Buffer &, cl_int>
+        march;
+    cl::make_kernel<cl::Buffer &, const cl::Buffer &, const cl::Buffer &, const cl::Buffer &>
+        shade;
+    cl::make_kernel<cl::Buffer &, cl::Buffer &, const cl::Buffer &, const cl::Buffer &> shadow;
+    cl::make_kernel<cl::Buffer &, const cl::Buffer &, const cl::Buffer &, cl_uint, cl_uint,
+                    cl_uint, const cl::Buffer &, cl_int, cl_uint, const cl::Buffer &, cl_int,
+                    const cl::Buffer &>
+        ao;
+    cl::make_kernel<cl::Image &, cl::Buffer &, cl::Buffer &, cl::Buffer &, const cl::Buffer &,
+                    cl_int, cl_uint, cl_uint, const cl::Buffer &, cl_int, cl_int>
+        accumulate;
+
+    WavefrontKernels(const cl::Program &program);
+  };
+
+  /**
+   * a built program and the hash of its source and build options, which keys the work-group sizes
+   * of its kernels
+   */
+  struct BuiltProgram {
+    cl::Program program;
+    uint64_t programHash;
+  };
+
+  static const size_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+  static const size_t PATH_STATE_SIZE = 5 * sizeof(cl_float4); // PathState in kernels/render.cl
+  static const size_t QUEUE_COUNTER_COUNT = 3; // the count of counters in 'queueCountersBuffer'
+  static const size_t CONE_LEVELS = 3;    // the count of levels of the cone prepass
+  static const size_t CONE_TILE_SIZE = 8; // the tile size of the finest level in pixels
+  static const size_t MAX_PINNED_IMAGES = 3; // the count of readbacks which may be pending
+  static const size_t BLUE_NOISE_SIZE = 64;  // BLUE_NOISE_SIZE in kernels/sampler.cl
+
+  size_t width;                // the width of the rendered image
+  size_t height;               // the height of the rendered image
+  size_t maxWidth;             // the width the buffers and the target image are allocated for
+  size_t maxHeight;            // the height the buffers and the target image are allocated for
+  bool sizeChanged;            // the render size or the row range changed, so the next pass
+                               // starts from scratch
+  cl_int sampleCount;          // the count of samples per pixel after the current pass
+  cl_int samplesPerLaunch;     // the count of samples per pixel of the current pass
+  size_t requestedSamplesPerLaunch; // is applied at the beginning of the next pass
+  size_t rowsPerLaunch;        // the count of rows rendered per launch, 0 means all rows
+  size_t rowOffset;            // the next launch starts at this row relative to 'firstRow'
+  size_t firstRow;             // the first row of the range of rows this renderer renders
+  size_t rowCount;             // the count of rows of the range, it is clamped to the height
+  cl_float3x4 vMatrix;         // view matrix
+  cl_float fov;                // has to be larger than 0, where larger values mean a smaller FOV
+  SceneParams sceneParams;     // the parameters of the scene
+  cl::Buffer sceneParamsBuffer; // 'sceneParams' in the layout of the kernels
+  bool sceneParamsChanged;     // 'sceneParamsBuffer' is uploaded before the next launch
+  cl::Context context;         // opencl context
+  cl::Device device;           // the hardware device that is used to render
+  cl::Program program;         // the rendering program with all the kernels
+  ProgramCache programCache;   // the on-disk cache of the compiled program binaries
+  cl::CommandQueue queue;      // the opencl queue
+  cl_uint randSeed;            // is added to the pixel indices, which key the random numbers
+  cl_uint sampleIndex;         // the index of the first sample of the current pass for the
+                               // random number generator
+  cl_uint nextSampleIndex;     // the index of the first sample of the next pass
+  cl::Buffer blueNoiseBuffer;  // the blue noise tile of the blue noise sampler
+  cl::Buffer imageRawBuffer;   // the raw image, each pixel has to be divided by its w component
+  cl::Buffer imageMomentBuffer;  // the sum of the squared luminance of the samples of each pixel
+  cl::Buffer activePixelsBuffer; // the indices of the pixels which aren't converged yet
+  cl::Buffer activeCountBuffer;  // the count of indices in 'activePixelsBuffer'
+  cl_uint activeCount;           // host copy of 'activeCountBuffer' of the current pass
+  const std::vector<cl_uint> zeros; // the source for resetting the counters on the device
+  bool adaptiveSampling;         // only renders the pixels which aren't converged yet
+  bool adaptivePass;             // the current pass only renders the active pixels
+  cl_float errorThreshold;       // the relative standard error at which a pixel is converged
+  size_t minAdaptiveSamples;     // the count of samples per pixel before pixels may converge
+  bool wavefront;                // renders with the wavefront kernels instead of the render kernel
+  size_t persistentThreads;      // the count of threads of the persistent wavefront kernels
+  cl::Buffer pathStatesBuffer;   // the states of the paths of the wavefront kernels
+  cl::Buffer hitQueueBuffer;     // the paths whose camera rays hit the scene
+  cl::Buffer queueCountersBuffer; // the counters of the wavefront queues
+  std::shared_ptr<WavefrontKernels> wavefrontKernels; // the kernels of the wavefront mode
+  bool conePrepass;              // the camera rays start from the distances of the cone prepass
+  bool coneStartValid;           // the cone prepass was rendered for the current view matrix
+  std::vector<cl::Buffer> coneStartBuffers; // the start distance and steps per tile and level
+  cl::Buffer hitPositionsBuffer;  // the hit point of the last sample per pixel, w is 0 for misses
+  bool temporalReprojection;      // reuses the samples of the previous view after camera changes
+  bool historyValid;              // every row of the raw image contains samples of a complete
+                                  // pass of the current view
+  bool reprojectPass;             // the current pass reprojects the samples of the previous view
+  cl_float maxHistorySamples;     // the maximal count of samples per pixel that are reprojected
+  cl_float3x4 passVMatrix;        // the view matrix of the current pass
+  cl_float passFov;               // the fov of the current pass
+  size_t passWidth;               // the width of the current pass
+  size_t passHeight;              // the height of the current pass
+  cl_float3x4 historyInvVMatrix;  // the inverse view matrix of the previous view
+  cl_float historyFov;            // the fov of the previous view
+  size_t historyWidth;            // the width of the previous view
+  size_t historyHeight;           // the height of the previous view
+  cl::Buffer historyRawBuffer;    // the raw image of the previous view
+  cl::Buffer historyMomentBuffer; // the moments of the previous view
+  cl::Buffer historyHitPositionsBuffer; // the hit points of the previous view
+  cl::Buffer reprojectedRawBuffer;      // the output of the reprojection kernel
+  std::shared_ptr<cl::make_kernel<cl::Image &, cl::Buffer &, cl::Buffer &, cl::Buffer &, cl_uint,
+                                  cl_uint, const cl::Buffer &, const cl::Buffer &,
+                                  const cl::Buffer &, cl_int, cl_int, cl_int, cl_int, cl_float,
+                                  const cl::Buffer &, cl_int, const cl::Buffer &, cl_int>>
+      renderKernelFunc; // the render kernel functor
+  std::shared_ptr<cl::make_kernel<cl::Image &, cl::Buffer &, cl::Buffer &, cl::Buffer &, cl_uint,
+                                  cl_uint, const cl::Buffer &, const cl::Buffer &,
+                                  const cl::Buffer &, cl_int, cl_int, cl_int, cl_int, cl_float,
+                                  const cl::Buffer &, cl_uint, const cl::Buffer &, cl_int,
+                                  const cl::Buffer &, cl_int>>
+      renderActiveKernelFunc; // renders only the pixels in 'activePixelsBuffer'
+  std::shared_ptr<cl::make_kernel<
+      cl::Image &, const cl::Buffer &, cl::Buffer &, cl::Buffer &, const cl::Buffer &,
+      const cl::Buffer &, const cl::Buffer &, const cl::Buffer &, const cl::Buffer &, cl_float4,
+      cl_float4, cl_float4, cl_int, cl_int, cl_int, cl_int, cl_float, cl_float, cl_int, cl_int,
+      cl_float>>
+      reprojectKernelFunc; // adds the reprojected samples of the previous view
+  std::shared_ptr<cl::make_kernel<const cl::Buffer &, cl::Buffer &, const cl::Buffer &,
+                                  const cl::Buffer &, cl_int, cl_int, cl_float, cl_int, cl_int>>
+      conePrepassKernelFunc; // marches the cones of one level of the cone prepass
+  std::shared_ptr<cl::make_kernel<const cl::Buffer &, const cl::Buffer &, cl_int, cl_int, cl_float,
+                                  cl::Buffer &, cl::Buffer &>>
+      compactKernelFunc; // collects the pixels which aren't converged yet
+  std::shared_ptr<cl::make_kernel<const cl::Buffer &, cl::Buffer &, cl_int, cl_int, cl_float>>
+      tonemapKernelFunc;  // the tonemap kernel functor
+  std::shared_ptr<WorkGroupTuner> renderTuner;  // the work-group size of the render kernel
+  std::shared_ptr<WorkGroupTuner> tonemapTuner; // the work-group size of the tonemap kernel
+  uint64_t programHash;             // the hash of the source and the build options of 'program'
+  size_t distanceFieldResolution;   // the resolution of the baked distance field, 0 disables it
+  std::shared_ptr<DistanceField> distanceField; // the field of 'program' and 'sceneParams', null
+                                                // until it is baked
+  cl::Buffer noDistanceFieldBuffer; // is passed to the kernels instead of a field with the
+                                    // resolution 0, which is never read
+  cl::Image2D imageBuffer; // the image the render kernel writes the normalized result to
+  std::vector<std::shared_ptr<PinnedImage>> pinnedImages; // the buffers of the readbacks
+  std::vector<FrameResources> frames; // ring buffer of the per frame resources
+  size_t currentFrame;                // the index of the frame in 'frames' that is rendered
+  size_t framesInFlight; // the count of frames which may be rendered at the same time
+  std::string sourceFilename;        // the opencl file of all program variants
+  std::string renderKernelName;      // the name of the render kernel e.g. raymarch
+  std::string buildOptions;          // the build options of 'program'
+  std::string requestedBuildOptions; // 'program' is replaced as soon as this variant is built
+  // all program variants by their build options, the variants which were requested with
+  // 'prepareProgram' are built in the background, the futures are declared last, so their
+  // destructors wait for the builds before the context is released
+  std::map<std::string, std::shared_future<BuiltProgram>> programVariants;
+
+  /**
+   * only initializes the members, the subclass has to setup the context, device and queue and
+   * has to call 'openProgram' and 'reshape' afterwards
+   */
+  CLRenderer(size_t width, size_t height);
+
+  /**
+   * the image that the render kernel writes to
+   */
+  virtual cl::Image &getTargetImage();
+
+  /**
+   * builds the variant of the program with the given build options or loads it from the program
+   * cache, it only reads members which stay the same after 'openProgram', so it may run on
+   * another thread, a failed build exits the application
+   */
+  BuiltProgram buildProgram(const std::string &buildOptions) const;
+
+  /**
+   * makes the built program the current one and creates its kernels
+   */
+  void useProgram(const BuiltProgram &built);
+
+  /**
+   * is called before the render kernel writes to the target image
+   */
+  virtual void acquireTargetImage() {}
+
+  /**
+   * is called after the render kernel was enqueued, afterwards the queue is flushed but not
+   * finished, so the host can already prepare the next frame
+   */
+  virtual void releaseTargetImage() {}
+
+  /**
+   * (re)creates the target image with the given size
+   */
+  virtual void reshapeTargetImage(size_t width, size_t height);
+
+  /**
+   * collects the pixels which aren't converged yet in 'activePixelsBuffer' and reads back their
+   * count to 'activeCount', the host has to know the count to size the following launch
+   */
+  void compactActivePixels();
+
+  /**
+   * renders 'samplesPerLaunch' samples for 'pixelCount' pixels with the wavefront kernels, the
+   * pixels are either the pixels in 'activePixelsBuffer' or the consecutive pixels beginning with
+   * 'pixelOffset'
+   *
+   * @return the event of the last kernel
+   */
+  cl::Event renderWavefront(const FrameResources &frame, cl_uint pixelOffset, cl_uint pixelCount,
+                            bool activePixels, bool reset);
+
+  /**
+   * (re)creates the buffers of the wavefront mode for the current image size, they are released
+   * if the wavefront mode is disabled
+   */
+  void reshapeWavefrontBuffers();
+
+  /**
+   * enqueues all levels of the cone prepass for the view matrix of the frame
+   */
+  void renderConePrepass(const FrameResources &frame);
+
+  /**
+   * adds the reprojected samples of the previous view to the given rows of the raw image
+   *
+   * @return the event of the last command
+   */
+  cl::Event renderReprojection(const FrameResources &frame, size_t firstRow, size_t rows);
+
+  /**
+   * (re)creates the buffers of the previous view for the current image size, they are released
+   * if the temporal reprojection is disabled
+   */
+  void reshapeHistoryBuffers();
+
+  /**
+   * enqueues the tonemapping (or the copy of the raw image) into the pinned buffer of the image
+   * and its mapping
+   */
+  void readPinnedImage(PinnedImage &image, bool hdr);
+
+public:
+  /**
+   * initializes opencl without an opengl context
+   *
+   * @param width the width of the desired image size
+   * @param height the height of the desired image size
+   * @param kernelname the name of the render kernel e.g. raymarch
+   * @param sourceFilename the filename of the opencl file
+   * @param buildOptions additional options for building the program e.g. -D SCENE_KALEIDO
+   * @param deviceIndex the index of the device in the list of all devices of all platforms
+   */
+  CLRenderer(size_t width, size_t height, const std::string &kernelname,
+             const std::string &sourceFilename, const std::string &buildOptions = "",
+             size_t deviceIndex = 0);
+
+  /**
+   * returns all opencl devices of all platforms in the order 'deviceIndex' refers to
+   */
+  static std::vector<cl::Device> getAllDevices();
+
+  /**
+   * opens and compiles a program with the given filename and the given kernel name
+   */
+  bool openProgram(const std::string &filename, const std::string &kernelname,
+                   const std::string &buildOptions = "");
+
+  /**
+   * starts building the variant of the program with the given build options (e.g. another scene)
+   * in the background, the current program is used in the meantime
+   */
+  void prepareProgram(const std::string &buildOptions);
+
+  /**
+   * switches to the variant of the program with the given build options, the switch happens with
+   * the first frame after the variant is built, that frame starts from scratch
+   */
+  void selectProgram(const std::string &buildOptions);
+
+  /**
+   * returns the build options of the variant of the program that is currently used
+   */
+  const std::string &getBuildOptions() const;
+
+  /**
+   * submits a frame which renders to the target image, it doesn't wait until the frame is done
+   *
+   * @param refresh if set to true the image gets flushed and starts with 1 samples, otherwise
+   * there will be generated continously new samples for AA
+   */
+  void render(bool refresh);
+
+  /**
+   * resizes the opencl buffers and the target image, the render size is set to the same size
+   *
+   * @param width the width of the desired image size
+   * @param height the height of the desired image size
+   */
+  void reshape(size_t width, size_t height);
+
+  /**
+   * the random numbers of the pixels are keyed with their index plus 'seed', so renderers with
+   * different seeds (e.g. for the tiles of a larger image) don't repeat the noise of each other,
+   * the indices of the samples start from 0 again
+   */
+  void setRandSeed(cl_uint seed);
+
+  /**
+   * renders only the given size in the lower left corner of the target image without
+   * reallocating any buffers, the size is clamped to the size given to 'reshape', the next pass
+   * starts from scratch (or from the reprojected samples of the previous size)
+   */
+  void setRenderSize(size_t width, size_t height);
+
+  void finish();
+
+  /**
+   * sets the count of samples per pixel which are rendered with a single kernel launch, it is
+   * applied as soon as the current pass is complete
+   */
+  void setSamplesPerLaunch(size_t samplesPerLaunch);
+
+  /**
+   * renders only the given count of rows per launch, so a pass over the whole image takes
+   * several frames, 0 renders the whole image with every launch
+   */
+  void setRowsPerLaunch(size_t rowsPerLaunch);
+
+  /**
+   * renders only the rows in [firstRow, firstRow + rowCount) of the image, e.g. the band of one
+   * device of several devices, the range is clamped to the render size and the rows outside of
+   * it are left untouched, the next pass starts from scratch if the range changed
+   */
+  void setRowRange(size_t firstRow, size_t rowCount);
+
+  /**
+   * returns the first row of the row range clamped to the render size
+   */
+  size_t getRangeBegin() const;
+
+  /**
+   * returns the count of rows of the row range clamped to the render size
+   */
+  size_t getRangeRows() const;
+
+  /**
+   * sets the count of frames which can be submitted before the oldest frame has to be finished
+   */
+  void setFramesInFlight(size_t framesInFlight);
+
+  /**
+   * stops rendering pixels as soon as the standard error of their mean luminance is below
+   * 'errorThreshold' relative to the mean, it is applied as soon as the current pass is complete
+   *
+   * @param minSamples the count of samples every pixel gets before it may be considered converged
+   */
+  void setAdaptiveSampling(bool enabled, float errorThreshold = 0.01f, size_t minSamples = 16);
+
+  bool getAdaptiveSampling() const;
+
+  /**
+   * renders with one kernel per stage (march, shade, shadow, ambient occlusion) instead of a
+   * single kernel, the march and shadow kernels use persistent threads, which keeps the SIMD lanes
+   * busy if the count of march steps varies a lot between neighbouring pixels
+   */
+  void setWavefront(bool enabled);
+
+  bool getWavefront() const;
+
+  /**
+   * marches cones through tiles of pixels before every pass, so the camera rays don't have to
+   * march through the empty space in front of the scene themselves
+   */
+  void setConePrepass(bool enabled);
+
+  bool getConePrepass() const;
+
+  /**
+   * reuses the samples of the previous view after the camera changed instead of starting with
+   * one sample per pixel, the samples are reprojected with the hit points of the pixels and
+   * rejected if the surface was occluded in the previous view
+   *
+   * @param maxHistorySamples the maximal count of reprojected samples per pixel, lower values let
+   * the image adapt faster to changes, which can't be reprojected (e.g. moving shadows)
+   */
+  void setTemporalReprojection(bool enabled, float maxHistorySamples = 16.0f);
+
+  bool getTemporalReprojection() const;
+
+  /**
+   * lets the march take its steps far from the surface from a distance field, which is baked once
+   * per scene and its parameters with 'resolution'^3 cells and stored in the cache directory, the
+   * exact distance estimate is only evaluated close to the surface, 0 disables the field
+   */
+  void setDistanceField(size_t resolution = DistanceField::DEFAULT_RESOLUTION);
+
+  /**
+   * returns the resolution of the distance field, 0 if it is disabled
+   */
+  size_t getDistanceField() const;
+
+  /**
+   * returns the count of pixels rendered by the current pass
+   */
+  size_t getActivePixelCount() const;
+
+  void setVMatrix(cl_float3x4 m);
+
+  void setVMatrix(glm::mat4 m);
+
+  void setFov(cl_float fov);
+
+  /**
+   * sets the parameters of the scene, they are uploaded before the next launch without rebuilding
+   * the program, the image has to be refreshed afterwards like after a change of the view
+   */
+  void setSceneParams(const SceneParams &params);
+
+  const SceneParams &getSceneParams() const;
+
+  /**
+   * returns the count of samples per pixel of all completed passes
+   */
+  size_t getSampleCount() const;
+
+  size_t getWidth() const;
+
+  size_t getHeight() const;
+
+  const cl::Device &getDevice() const;
+
+  /**
+   * returns the tonemapped image in RGBA order (8 bit per channel)
+   */
+  std::vector<uint8_t> getImage();
+
+  /**
+   * reads the tonemapped image (or the raw image if 'hdr' is set) back into a pinned host buffer
+   * without blocking, the image has to be released as soon as the pixels are processed
+   *
+   * @return nullptr if the buffers of all previous readbacks are still in use
+   */
+  std::shared_ptr<PinnedImage> getImageAsync(bool hdr = false);
+
+  /**
+   * returns the content of the raw image buffer in RGBA order, each pixel has to be divided by
+   * its alpha component, which is the count of samples of the pixel
+   */
+  std::vector<float> getRawImage();
+
+  /**
+   * reads the raw image buffer asynchronously to 'pixels', see 'getRawImage', the vector must not
+   * be accessed until the returned event is complete
+   */
+  cl::Event getRawImageAsync(std::vector<float> &pixels);
+
+  /**
+   * writes the accumulated image, the moments, the index of the next sample of the random number
+   * generator and the sample count into a memory mapped checkpoint file, the buffers are read
+   * directly into the mapping, the file is written under a temporary name and renamed afterwards,
+   * so an interrupted save doesn't destroy the previous checkpoint
+   *
+   * @return false if the file couldn't be written
+   */
+  bool saveCheckpoint(const std::string &filename);
+
+  /**
+   * continues the accumulation of a checkpoint, which has to have the current render size, the
+   * view matrix and the fov of the checkpoint are restored too, the next frame has to be rendered
+   * without a refresh
+   *
+   * @return false if the file couldn't be read or doesn't match the render size
+   */
+  bool loadCheckpoint(const std::string &filename);
+
+  /**
+   * returns the given rows of the raw image buffer, see 'getRawImage'
+   */
+  std::vector<float> getRawImage(size_t firstRow, size_t rowCount);
+
+  /**
+   * returns the given rows of the normalized image the render kernel writes to in RGBA order, it
+   * can only be used if the target image isn't shared with opengl
+   */
+  std::vector<float> getTargetRows(size_t firstRow, size_t rowCount);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Renderer.hpp"
+#include "TileScheduler.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * renders natively on the host with all cores and doesn't need an opencl ICD, the scenes are
+ * approximations of the ones of the opencl kernels with the default SceneParams, see
+ * src/CPURenderer.cpp
+ */
+class CPURenderer : public Renderer {
+public:
+  /**
+   * the scenes which are available, they correspond to the files kernels/raymarch_*.cl
+   */
+  enum Scene { MENGER, KALEIDO };
+
+private:
+  static const size_t TILE_SIZE = 16; // the width and height of the tiles in pixels
+
+  size_t width;
+  size_t height;
+  size_t sampleCount;                 // the count of samples per pixel
+  size_t samplesPerLaunch;            // the count of samples per pixel rendered by 'render'
+  glm::mat4 vMatrix;                  // view matrix
+  float fov;                          // has to be larger than 0, larger values mean a smaller FOV
+  Scene scene;                        // the scene that is rendered
+  std::vector<glm::vec4> imageRaw;    // the raw image, each pixel has to be divided by sampleCount
+  std::vector<glm::uvec4> randStates; // the states for random number generation
+  TileScheduler scheduler;            // distributes the tiles over the worker threads
+
+  /**
+   * renders one sample for every pixel of the given tile
+   */
+  template <typename SceneT> void renderTile(size_t tile);
+
+public:
+  /**
+   * @param width the width of the desired image size
+   * @param height the height of the desired image size
+   * @param scene the scene that is rendered
+   * @param threadCount the count of worker threads, 0 means one per hardware thread
+   */
+  CPURenderer(size_t width, size_t height, Scene scene = MENGER, size_t threadCount = 0);
+
+  void render(bool refresh);
+
+  void reshape(size_t width, size_t height);
+
+  void finish();
+
+  void setVMatrix(glm::mat4 m);
+
+  void setFov(float fov);
+
+  void setSamplesPerLaunch(size_t samplesPerLaunch);
+
+  size_t getSampleCount() const;
+
+  size_t getWidth() const;
+
+  size_t getHeight() const;
+
+  size_t getThreadCount() const;
+
+  std::vector<uint8_t> getImage();
+
+  std::vector<float> getRawImage();
+};
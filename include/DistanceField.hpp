@@ -0,0 +1,55 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+
+#include "ProgramCache.hpp"
+#include "SceneParams.hpp"
+#include <CL/cl.hpp>
+#include <cstdint>
+#include <string>
+
+/**
+ * the header of a cached distance field, it is followed by the distances of all cells
+ */
+struct DistanceFieldHeader {
+  char magic[8];      // "PMCLDFD1"
+  cl_uint resolution; // the count of cells along each axis
+};
+
+/**
+ * a grid of lower bounds of the distance to the surface of the scene, which the march uses for
+ * its steps far from the surface instead of the distance estimate (see 'bakeDistanceField' in
+ * kernels/render.cl), the grid is baked on the device once and stored in the cache directory keyed
+ * by the program and the parameters of the scene, so later starts with the same scene load it
+ */
+class DistanceField {
+  cl::Buffer buffer;    // the distances of the cells, x varies fastest, then y
+  cl_int resolution;    // the count of cells along each axis
+  std::string filename; // the cached field, empty disables the cache
+
+  bool load(const cl::Context &context);
+
+  void store(cl::CommandQueue &queue) const;
+
+public:
+  static const size_t DEFAULT_RESOLUTION = 128;
+
+  /**
+   * loads the field from the cache or bakes it, a baked field is read back into the cache right
+   * away, so baking blocks until the field is done
+   *
+   * @param program the program of the scene, which contains 'bakeDistanceField'
+   * @param programHash identifies the source and the build options of the program
+   * @param sceneParamsBuffer the parameters of the scene, they have to be uploaded already
+   * @param params the parameters in 'sceneParamsBuffer', which are part of the key of the cache
+   * @param directory the cache directory, if it is empty the field is always baked
+   */
+  DistanceField(const cl::Context &context, cl::CommandQueue &queue, const cl::Program &program,
+                uint64_t programHash, const cl::Buffer &sceneParamsBuffer,
+                const cl_scene_params &params, size_t resolution = DEFAULT_RESOLUTION,
+                const std::string &directory = ProgramCache::defaultDirectory());
+
+  const cl::Buffer &getBuffer() const;
+
+  cl_int getResolution() const;
+};
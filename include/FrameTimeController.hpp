@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * chooses the work per frame, so that the frame time approaches a target frame time: on fast
+ * devices several samples per pixel are rendered with a single launch, on slow devices only a
+ * fraction of the image is rendered per frame
+ */
+class FrameTimeController {
+  double targetFrameTime;     // in seconds, values <= 0 disable the controller
+  double work;                // samples per pixel per frame, values < 1 are a fraction of the image
+  size_t maxSamplesPerLaunch; // the upper bound of the work
+  const double minWork = 1.0 / 16.0;
+
+public:
+  FrameTimeController(double targetFrameTime = 1.0 / 30.0, size_t maxSamplesPerLaunch = 64)
+      : targetFrameTime(targetFrameTime), work(1.0), maxSamplesPerLaunch(maxSamplesPerLaunch) {}
+
+  void setTargetFrameTime(double targetFrameTime) {
+    this->targetFrameTime = targetFrameTime;
+    work = 1.0;
+  }
+
+  double getTargetFrameTime() const { return targetFrameTime; }
+
+  bool isEnabled() const { return targetFrameTime > 0.0; }
+
+  /**
+   * adapts the work to the measured time of the last frame in seconds
+   */
+  void update(double frameTime) {
+    if (!isEnabled() || frameTime <= 0.0)
+      return;
+    // the correction is damped, so single slow frames don't cause the work to oscillate
+    const double ratio = std::min(2.0, std::max(0.5, targetFrameTime / frameTime));
+    work = std::min((double)maxSamplesPerLaunch, std::max(minWork, work * std::sqrt(ratio)));
+  }
+
+  size_t getSamplesPerLaunch() const { return isEnabled() && work >= 1.0 ? (size_t)work : 1; }
+
+  /**
+   * returns the fraction of the image which should be rendered per frame
+   */
+  double getImageFraction() const { return isEnabled() ? std::min(1.0, work) : 1.0; }
+};
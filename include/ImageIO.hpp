@@ -0,0 +1,104 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace imageio {
+/**
+ * writes an 8 bit image in RGBA order as binary PPM (the alpha channel is dropped), the first row
+ * of 'pixels' is the top row of the image
+ */
+extern bool writePPM(const std::string &filename, size_t width, size_t height,
+                     const std::vector<uint8_t> &pixels);
+
+/**
+ * writes an 8 bit image in RGBA order as uncompressed 24 bit BMP (the alpha channel is dropped),
+ * the first row of 'pixels' is the top row of the image
+ */
+extern bool writeBMP(const std::string &filename, size_t width, size_t height,
+                     const std::vector<uint8_t> &pixels);
+
+/**
+ * writes a float image in RGBA order as little endian PFM (the alpha channel is dropped), every
+ * channel is multiplied by 'scale', the first row of 'pixels' is the top row of the image
+ */
+extern bool writePFM(const std::string &filename, size_t width, size_t height,
+                     const std::vector<float> &pixels, float scale = 1.0f);
+
+/**
+ * an image file whose pixel data is memory mapped, so images which don't fit into the host memory
+ * can be written tile by tile, the written rows can be released from the address space, so only
+ * the rows of the tiles which are currently written are resident
+ */
+class MappedImage {
+public:
+  enum Format { PPM, PFM };
+
+private:
+  Format format;
+  size_t width;
+  size_t height;
+  size_t headerSize; // the size of the header in bytes, the pixels follow directly
+  MappedFile file;
+
+  size_t pixelSize() const;
+
+  /**
+   * returns the offset of the pixel (x, y) in the file, y = 0 is the top row of the image
+   */
+  size_t pixelOffset(size_t x, size_t y) const;
+
+public:
+  /**
+   * creates the file with the given size (its content is black until tiles are written)
+   */
+  MappedImage(const std::string &filename, size_t width, size_t height, Format format);
+
+  bool isOpen() const;
+
+  /**
+   * writes a tile of accumulated pixels in RGBA order, the alpha component is the count of
+   * samples of the pixel, PPM images are tonemapped like kernels/tonemap.cl, the first row of
+   * 'pixels' is the top row of the tile
+   */
+  void writeTile(size_t x, size_t y, size_t tileWidth, size_t tileHeight, const float *pixels);
+
+  /**
+   * starts writing back the given rows and removes them from the address space of the process
+   */
+  void releaseRows(size_t firstRow, size_t rowCount);
+
+  /**
+   * writes all rows back to the file and closes it
+   *
+   * @return false if the file couldn't be written
+   */
+  bool close();
+};
+
+/**
+ * tonemaps a channel of a normalized pixel to 8 bit like kernels/tonemap.cl (simple Reinhard and a
+ * gamma of 2.2)
+ */
+extern uint8_t tonemapChannel(float value);
+
+/**
+ * tonemaps a raw image in RGBA order, whose alpha components are the counts of samples of the
+ * pixels, to an 8 bit image in RGBA order with an opaque alpha channel, see 'tonemapChannel'
+ */
+extern std::vector<uint8_t> tonemap(const float *pixels, size_t pixelCount);
+
+/**
+ * divides every pixel of a raw image in RGBA order by its alpha component, which is the count of
+ * samples of the pixel (it may differ between the pixels, e.g. with adaptive sampling)
+ */
+extern void normalizeSamples(std::vector<float> &pixels);
+
+/**
+ * returns true if the filename ends with the given extension (case insensitive), e.g. ".pfm"
+ */
+extern bool hasExtension(const std::string &filename, const std::string &extension);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CLRenderer.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * encodes and writes images on a background thread, so captures don't stall the render loop, the
+ * queue of the writer is bounded and new images are rejected as long as it is full
+ */
+class ImageWriter {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<std::function<void()>> jobs; // the pending jobs in the order of submission
+  size_t maxJobs;                         // the capacity of the queue
+  bool quit;
+
+  void workerLoop();
+
+public:
+  /**
+   * @param maxJobs the count of images which may wait to be written
+   */
+  ImageWriter(size_t maxJobs = 4);
+
+  /**
+   * writes all pending images before the thread quits
+   */
+  ~ImageWriter();
+
+  /**
+   * runs the job on the writer thread
+   *
+   * @return false if the queue is full and the job was dropped
+   */
+  bool submit(const std::function<void()> &job);
+
+  /**
+   * writes the readback to a file as soon as it is complete and releases it afterwards, HDR
+   * images are written as PFM, tonemapped images as BMP if the filename ends with .bmp and as PPM
+   * otherwise
+   *
+   * @return false if the queue is full, the image is released immediately in this case
+   */
+  bool submit(const std::string &filename, const std::shared_ptr<CLRenderer::PinnedImage> &image);
+};
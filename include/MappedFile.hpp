@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * a file which is mapped into the address space, the pages are only loaded on access and written
+ * back by the kernel, so files larger than the host memory can be read and written
+ */
+class MappedFile {
+  int fd;        // the file descriptor, -1 if the file couldn't be opened
+  uint8_t *data; // the mapped file, nullptr if the file couldn't be mapped
+  size_t size;   // the size of the file in bytes
+
+public:
+  /**
+   * creates the file with the given size (or truncates an existing one) and maps it writable, the
+   * content is zero until it is written
+   */
+  MappedFile(const std::string &filename, size_t size);
+
+  /**
+   * maps an existing file read-only
+   */
+  MappedFile(const std::string &filename);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool isOpen() const;
+
+  uint8_t *getData();
+
+  const uint8_t *getData() const;
+
+  size_t getSize() const;
+
+  /**
+   * starts writing back the given range and removes it from the address space of the process,
+   * only the whole pages in the range are released
+   */
+  void release(size_t offset, size_t length);
+
+  /**
+   * writes all pages back to the file and closes it
+   *
+   * @return false if the file couldn't be written
+   */
+  bool close();
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "CLRenderer.hpp"
+#include "Renderer.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * renders with several opencl devices at the same time (e.g. a GPU, an iGPU and a CPU device),
+ * every device renders a band of rows into its own buffers, the height of the bands is rebalanced
+ * with the measured speed of the devices, so all devices need about the same time per frame
+ */
+class MultiDeviceRenderer : public Renderer {
+  static const size_t ROW_GRANULARITY = 8; // the bands are multiples of the work-group height
+
+  std::vector<std::shared_ptr<CLRenderer>> renderers; // one renderer per device
+  std::vector<double> rowsPerSecond; // the smoothed measured speed of every device, 0 if unknown
+  std::vector<size_t> bandRows;      // the count of rows of the band of every device
+  size_t splitHeight;                // the height the bands were computed for
+  const double rebalanceGain = 1.1;  // the minimal speedup for rebalancing an accumulated image
+
+  /**
+   * distributes the rows of the image proportionally to the measured speed of the devices
+   */
+  std::vector<size_t> computeSplit(size_t height) const;
+
+  /**
+   * returns the estimated time of a frame with the given bands
+   */
+  double estimateFrameTime(const std::vector<size_t> &rows) const;
+
+  void applySplit(const std::vector<size_t> &rows);
+
+public:
+  /**
+   * renders with the given renderers, the first renderer may be an OCLRenderer which displays
+   * the result, the renderers render all rows of their band with every frame
+   */
+  MultiDeviceRenderer(const std::vector<std::shared_ptr<CLRenderer>> &renderers);
+
+  /**
+   * initializes one renderer for every opencl device of every platform
+   *
+   * @param width the width of the desired image size
+   * @param height the height of the desired image size
+   * @param kernelname the name of the render kernel e.g. raymarch
+   * @param sourceFilename the filename of the opencl file
+   * @param buildOptions additional options for building the program e.g. -D SCENE_KALEIDO
+   */
+  MultiDeviceRenderer(size_t width, size_t height, const std::string &kernelname,
+                      const std::string &sourceFilename, const std::string &buildOptions = "");
+
+  /**
+   * renders a frame on all devices and blocks until all devices are done, the time of every
+   * device is used to rebalance the bands, the new bands are applied immediately with a refresh
+   * and while the image is accumulated only if the frame time improves noticeably
+   */
+  void render(bool refresh);
+
+  void reshape(size_t width, size_t height);
+
+  /**
+   * sets the render size of all devices, see CLRenderer::setRenderSize
+   */
+  void setRenderSize(size_t width, size_t height);
+
+  void finish();
+
+  void setVMatrix(glm::mat4 m);
+
+  void setFov(float fov);
+
+  /**
+   * sets the parameters of the scene of all devices, see CLRenderer::setSceneParams
+   */
+  void setSceneParams(const SceneParams &params);
+
+  void setSamplesPerLaunch(size_t samplesPerLaunch);
+
+  /**
+   * returns the lowest count of samples per pixel of all devices, the devices whose band changed
+   * started from scratch
+   */
+  size_t getSampleCount() const;
+
+  size_t getWidth() const;
+
+  size_t getHeight() const;
+
+  const std::vector<std::shared_ptr<CLRenderer>> &getRenderers() const;
+
+  /**
+   * returns the tonemapped image in RGBA order (8 bit per channel)
+   */
+  std::vector<uint8_t> getImage();
+
+  /**
+   * returns the raw images of all bands merged together, each pixel has to be divided by its
+   * alpha component, which is the count of samples of the pixel
+   */
+  std::vector<float> getRawImage();
+};
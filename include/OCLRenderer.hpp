@@ -1,80 +1,54 @@
 #pragma once
 
-#define __CL_ENABLE_EXCEPTIONS
-
+#include "CLRenderer.hpp"
 #include "Texture.hpp"
-#include <CL/cl.hpp>
-#include <glm/glm.hpp>
+#include <CL/cl_gl_ext.h>
 #include <memory>
 
-typedef struct { cl_float4 m[3]; } cl_float3x4; // for the view matrix
-
-class OCLRenderer {
-  cl_int sampleCount;          // the count of samples per pixel
-  cl_float3x4 vMatrix;         // view matrix
-  cl_float fov;                // has to be larger than 0, where larger values mean a smaller FOV
-  cl::Context context;         // opencl context
-  cl::Device device;           // the hardware device that is used to render
-  cl::Program program;         // the rendering program with all the kernels
-  cl::CommandQueue queue;      // the opencl queue
-  cl::Buffer randStatesBuffer; // the states for random number generation
-  cl::Buffer imageRawBuffer;   // the raw image, each pixel has to be divided by 'sampleCount'
-  std::shared_ptr<cl::make_kernel<cl::ImageGL &, cl::Buffer &, cl::Buffer &, const cl::Buffer &,
-                                  cl_int, cl_int, cl_int, cl_float>>
-      renderKernelFunc; // the render kernel functor
-  std::shared_ptr<
-      cl::make_kernel<const cl::Buffer &, cl::Buffer &, cl_int, cl_int, cl_float, cl_float>>
-      tonemapKernelFunc;          // the tonemap kernel functor
+/**
+ * renders with opencl directly into an opengl texture, which is shared with the current opengl
+ * context
+ */
+class OCLRenderer : public CLRenderer {
   std::vector<cl::Memory> glObjs; // shared opengl objects, it should be for now only the texture
 #ifdef CL_VERSION_1_2
-  cl::ImageGL imageBuffer; // the wrapping buffer for the shared opengl texture
+  cl::ImageGL glImageBuffer; // the wrapping buffer for the shared opengl texture
 #else
-  cl::Image2DGL imageBuffer;
+  cl::Image2DGL glImageBuffer;
 #endif
   Texture texture; // the texture that is containing the rendered result
+  clCreateEventFromGLsyncKHR_fn createEventFromGLsync; // is null if cl_khr_gl_event is missing
+  std::vector<GLsync> glSyncs; // the opengl fences the frames in flight are waiting for
 
-public:
   /**
-   * initializes opencl
-   *
-   * @param width the width of the desired texture size
-   * @param height the height of the desired texture size
-   * @param kernelname the name of the kernel e.g. mandelbrot, julia_set or mandelbrot_alt
-   * @param sourceFilename the filename of the opencl file
+   * checks if the device supports cl_khr_gl_event, otherwise the host has to synchronize opengl
+   * and opencl with glFinish and finish
    */
-  OCLRenderer(size_t width, size_t height, const std::string &kernelname,
-              const std::string &sourceFilename);
+  void setupGLSync();
 
-  /**
-   * opens and compiles a program with the given filename and the given kernel name
-   */
-  bool openProgram(const std::string &filename, const std::string &kernelname);
+protected:
+  cl::Image &getTargetImage();
 
-  /**
-   * renders to the texture
-   *
-   * @param refresh if set to true the texture gets flushed and starts with 1 samples, otherwise
-   * there will be generated continously new samples for AA
-   */
-  void render(bool refresh);
+  void acquireTargetImage();
 
-  const Texture &getTexture() const;
+  void releaseTargetImage();
+
+  void reshapeTargetImage(size_t width, size_t height);
 
+public:
   /**
-   * resizes the opencl buffers and the texture
+   * initializes opencl
    *
    * @param width the width of the desired texture size
    * @param height the height of the desired texture size
+   * @param kernelname the name of the kernel e.g. mandelbrot, julia_set or mandelbrot_alt
+   * @param sourceFilename the filename of the opencl file
+   * @param buildOptions additional options for building the program e.g. -D SCENE_KALEIDO
    */
-  void reshape(size_t width, size_t height);
-
-  void setVMatrix(cl_float3x4 m);
-
-  void setVMatrix(glm::mat4 m);
-
-  void setFov(cl_float fov);
+  OCLRenderer(size_t width, size_t height, const std::string &kernelname,
+              const std::string &sourceFilename, const std::string &buildOptions = "");
 
-  size_t getSampleCount() const;
+  ~OCLRenderer();
 
-  std::vector<uint8_t> getImage();
+  const Texture &getTexture() const;
 };
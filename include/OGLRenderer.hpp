@@ -1,6 +1,11 @@
 #pragma once
 
+#include "FrameTimeController.hpp"
+#include "ImageWriter.hpp"
+#include "MultiDeviceRenderer.hpp"
 #include "OCLRenderer.hpp"
+#include "RenderScaleController.hpp"
+#include "SceneRegistry.hpp"
 #include "ShaderProgram.hpp"
 #include <SDL2/SDL.h>
 #include <chrono>
@@ -10,12 +15,47 @@
 class OGLRenderer {
   std::shared_ptr<ShaderProgram> renderShaderProgram;
   std::shared_ptr<OCLRenderer> oclRenderer;
+  std::shared_ptr<MultiDeviceRenderer> multiDeviceRenderer; // is null unless several devices render
   GLuint renderVao;
   GLuint renderVbo;
   bool needUpdate; // if this is set to true, the samples per pixel will be resetted
+  FrameTimeController frameTimeController; // chooses the samples per launch or rows per launch
+  RenderScaleController renderScaleController; // lowers the resolution while the camera moves
+  size_t windowWidth;                          // the size of the window in pixels
+  size_t windowHeight;
+  double lastFrameTime; // the time of the last frame in seconds
+  glm::mat4 vMatrix;    // the view matrix, which is given to the renderers of new devices
+  float fov;
+  const SceneVariant *scene; // the displayed scene, one of 'scenes::all'
+  ImageWriter imageWriter; // writes the captures, it is destroyed before the renderers
+
+  /**
+   * reads the image back asynchronously and writes it on the writer thread, HDR images are
+   * written as PFM, tonemapped images as BMP
+   */
+  void saveImage(const std::string &filename, bool hdr);
+
+  /**
+   * returns the renderer which renders the displayed image
+   */
+  Renderer &getRenderer();
+
+  /**
+   * returns the renderers of all devices which render the displayed image
+   */
+  std::vector<std::shared_ptr<CLRenderer>> getDeviceRenderers() const;
+
+  /**
+   * uploads the bands of the other devices into the displayed texture
+   */
+  void mergeDeviceBands();
 
 public:
-  OGLRenderer(size_t width, size_t height);
+  /**
+   * the programs of the other scenes are built in the background, so switching the scene doesn't
+   * stall the window
+   */
+  OGLRenderer(size_t width, size_t height, const SceneVariant &scene);
 
   ~OGLRenderer();
 
@@ -49,9 +89,70 @@ public:
    */
   void setFov(float fov);
 
+  /**
+   * adapts the work per frame to the measured time of the last frame in seconds
+   */
+  void updateFrameTime(double frameTime);
+
+  /**
+   * sets the frame time in seconds the work per frame is adapted to, 0 disables the adaption and
+   * renders one sample per pixel per frame
+   */
+  void setTargetFrameTime(double targetFrameTime);
+
+  double getTargetFrameTime() const;
+
+  /**
+   * toggles if the resolution is lowered while the camera moves
+   */
+  void toggleDynamicResolution();
+
+  /**
+   * toggles if converged pixels are skipped while the image is accumulated
+   */
+  void toggleAdaptiveSampling();
+
+  /**
+   * toggles between the single render kernel and the wavefront kernels
+   */
+  void toggleWavefront();
+
+  /**
+   * toggles if the camera rays start from the distances of the cone prepass
+   */
+  void toggleConePrepass();
+
+  /**
+   * toggles if the march takes its steps far from the surface from the baked distance field
+   */
+  void toggleDistanceField();
+
+  /**
+   * toggles if the samples of the previous view are reused after the camera moved
+   */
+  void toggleTemporalReprojection();
+
+  /**
+   * toggles if all opencl devices render a band of the image instead of only the device of the
+   * opengl context
+   */
+  void toggleMultiDevice();
+
+  /**
+   * switches all devices to the next scene of 'scenes::all', the current scene is displayed until
+   * the program of the next scene is built
+   */
+  void nextScene();
+
   /**
    * saves a screencapture in the current directory with the following name scheme:
    * {filenamePrefix}{CURRENT_TIME}_{SAMPLE_COUNT}_Spp.bmp
    */
   void saveRenderedImage(const std::string &filenamePrefix = "render_");
+
+  /**
+   * saves the unmodified HDR accumulation as PFM in the current directory with the following
+   * name scheme: {filenamePrefix}{CURRENT_TIME}_{SAMPLE_COUNT}_Spp.pfm
+   */
+  void saveRenderedImageHDR(const std::string &filenamePrefix = "render_");
 };
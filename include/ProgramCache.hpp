@@ -0,0 +1,60 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+
+#include <CL/cl.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * an on-disk cache for compiled opencl programs, the binaries are keyed on the source with all
+ * included files, the build options, the device name and the driver version
+ */
+class ProgramCache {
+  std::string directory; // the cache directory, caching is disabled if it is empty
+
+  /**
+   * returns the filename of the cached binary for the given key
+   */
+  std::string cacheFilename(const cl::Device &device, const std::string &source,
+                            const std::string &options) const;
+
+public:
+  /**
+   * @param directory the directory the binaries are saved in, if it is empty nothing is cached
+   */
+  ProgramCache(const std::string &directory = defaultDirectory());
+
+  /**
+   * returns $PATHMARCHCL_CACHE_DIR if set, otherwise $XDG_CACHE_HOME/PathMarchCL or
+   * ~/.cache/PathMarchCL
+   */
+  static std::string defaultDirectory();
+
+  /**
+   * 64 bit FNV-1a hash, e.g. for keys derived from the source of a program
+   */
+  static uint64_t hash(const std::string &str);
+
+  /**
+   * reads the source file and recursively replaces every #include "..." with the content of the
+   * included file, which is searched relative to the including file and in 'includeDirs'
+   */
+  static std::string readSource(const std::string &filename,
+                                const std::vector<std::string> &includeDirs);
+
+  /**
+   * creates and builds the program from a cached binary
+   *
+   * @return false if there is no valid binary for the given key in the cache
+   */
+  bool load(const cl::Context &context, const cl::Device &device, const std::string &source,
+            const std::string &options, cl::Program &program) const;
+
+  /**
+   * saves the binary of the built program in the cache
+   */
+  void store(const cl::Program &program, const cl::Device &device, const std::string &source,
+             const std::string &options) const;
+};
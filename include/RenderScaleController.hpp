@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * chooses the fraction of the window resolution that is rendered: while the camera moves the
+ * scale is lowered until the frame time approaches a target frame time, as soon as the camera
+ * stands still the native resolution is rendered again
+ */
+class RenderScaleController {
+  double targetFrameTime; // in seconds, values <= 0 disable the controller
+  double movingScale;     // the scale used while the camera moves, it is kept between movements
+  double stillTime;       // the time in seconds since the camera moved the last time
+  double scale;           // the current scale of the width and height
+  const double minScale = 0.25;
+  const double settleTime = 0.15; // the camera has to stand still this long for native resolution
+  const double scaleStep = 1.0 / 16.0; // the scale is quantized to avoid resizing every frame
+
+public:
+  RenderScaleController(double targetFrameTime = 1.0 / 30.0)
+      : targetFrameTime(targetFrameTime), movingScale(1.0), stillTime(0.0), scale(1.0) {}
+
+  void setTargetFrameTime(double targetFrameTime) {
+    this->targetFrameTime = targetFrameTime;
+    movingScale = 1.0;
+    scale = 1.0;
+  }
+
+  double getTargetFrameTime() const { return targetFrameTime; }
+
+  bool isEnabled() const { return targetFrameTime > 0.0; }
+
+  /**
+   * adapts the scale to the measured time of the last frame in seconds
+   *
+   * @param moving true if the view changed since the last frame
+   */
+  void update(bool moving, double frameTime) {
+    if (!isEnabled())
+      return;
+    stillTime = moving ? 0.0 : stillTime + frameTime;
+    if (!moving) {
+      if (stillTime >= settleTime)
+        scale = 1.0;
+      return;
+    }
+    if (frameTime > 0.0) {
+      // the frame time is proportional to the count of pixels, i.e. the square of the scale, the
+      // correction is damped like the one of the FrameTimeController
+      const double ratio = std::min(2.0, std::max(0.5, targetFrameTime / frameTime));
+      movingScale = std::min(1.0, std::max(minScale, movingScale * std::pow(ratio, 0.25)));
+    }
+    scale = std::max(minScale, std::round(movingScale / scaleStep) * scaleStep);
+  }
+
+  double getScale() const { return isEnabled() ? scale : 1.0; }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * the common contract of all rendering backends, which accumulate continously new samples per
+ * pixel into a raw image
+ */
+class Renderer {
+public:
+  virtual ~Renderer() {}
+
+  /**
+   * renders a new sample per pixel
+   *
+   * @param refresh if set to true the image gets flushed and starts with 1 samples, otherwise
+   * there will be generated continously new samples for AA
+   */
+  virtual void render(bool refresh) = 0;
+
+  /**
+   * resizes the image
+   */
+  virtual void reshape(size_t width, size_t height) = 0;
+
+  /**
+   * blocks until all submitted frames are rendered
+   */
+  virtual void finish() = 0;
+
+  virtual void setVMatrix(glm::mat4 m) = 0;
+
+  virtual void setFov(float fov) = 0;
+
+  /**
+   * sets the count of samples per pixel which are rendered with every call of 'render'
+   */
+  virtual void setSamplesPerLaunch(size_t samplesPerLaunch) = 0;
+
+  virtual size_t getSampleCount() const = 0;
+
+  virtual size_t getWidth() const = 0;
+
+  virtual size_t getHeight() const = 0;
+
+  /**
+   * returns the tonemapped image in RGBA order (8 bit per channel)
+   */
+  virtual std::vector<uint8_t> getImage() = 0;
+
+  /**
+   * returns the raw accumulated image in RGBA order, each pixel has to be divided by the sample
+   * count
+   */
+  virtual std::vector<float> getRawImage() = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+
+#include <CL/cl.hpp>
+#include <glm/glm.hpp>
+
+/**
+ * the layout of SceneParams in kernels/common.cl
+ */
+typedef struct {
+  cl_float4 kifsTransform[4]; // the transposed transform of one iteration of the kaleido scene
+  cl_float4 light;            // xyz the position of the light
+  cl_float4 lightColor;
+  cl_float4 matColor;
+  cl_float4 backgroundColor;
+  cl_float4 mengerOffset;
+  cl_float kifsInvScale;        // the distance scale of one kaleido iteration
+  cl_float kifsLodFactor;       // 1 / log2(kifsScale), see 'lodIterations' in kernels/common.cl
+  cl_float kifsBoundingRadius;  // the radius of the bounding sphere of the kaleido scene
+  cl_float mengerScale;
+  cl_float mengerInvScale;      // the distance scale of one menger iteration
+  cl_float mengerLodFactor;     // 1 / log2(mengerScale)
+  cl_float shadowSoftness;
+  cl_float shadowMinLight;
+  cl_float footprintEpsilon;
+  cl_float relaxation;
+  cl_int kifsIterations;
+  cl_int mengerIterations;
+} cl_scene_params;
+
+/**
+ * the parameters of the scenes, the kernels read them from a constant buffer, so they can be
+ * changed without rebuilding the program, the values derived from them (e.g. the transform of the
+ * kaleido iterations) are computed once by 'toCL' instead of per distance evaluation
+ */
+struct SceneParams {
+  // the kaleido scene, every iteration folds the point into the positive octant and applies the
+  // rotation about 'kifsAxis', the scale and the offset
+  glm::vec3 kifsOffset = glm::vec3(-0.4f, -0.9f, -0.49f);
+  glm::vec3 kifsAxis = glm::vec3(1.0f, 1.0f, 2.1f); // is normalized by 'toCL'
+  float kifsAngle = 40.0f;                          // in degrees
+  float kifsScale = 1.5f;
+  int kifsIterations = 40; // the most iterations, distant points get fewer
+  glm::vec3 light = glm::vec3(2.0f, -4.0f, -9.0f);
+  glm::vec3 lightColor = 19.0f * glm::vec3(1.0f, 0.9f, 0.8f);
+  glm::vec3 matColor = glm::vec3(1.0f);
+  float shadowSoftness = 4.0f;
+  float shadowMinLight = 0.07f; // the fraction of the light that reaches fully shadowed points
+
+  // the menger sponge
+  float mengerScale = 3.0f;
+  glm::vec3 mengerOffset = glm::vec3(1.0f);
+  int mengerIterations = 10; // the most iterations, distant points get fewer
+
+  glm::vec3 backgroundColor = glm::vec3(0.0f);
+
+  // the march, a ray hits the surface as soon as the distance estimate falls below
+  // 'footprintEpsilon' times the radius of the footprint of its pixel (0 stops at the fixed
+  // RAYMARCH_PRECISION), the steps are over-relaxed by 'relaxation' (1 disables it, it is clamped
+  // to [1, 1.9]), a relaxed step that could have skipped the surface is taken back
+  float footprintEpsilon = 1.0f;
+  float relaxation = 1.2f;
+
+  /**
+   * returns the parameters in the layout of the kernels
+   */
+  cl_scene_params toCL() const;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "SceneParams.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * a scene and the constants its program is specialized with, every scene is built as its own
+ * program, which only contains the features the scene uses, the iteration counts stay in the
+ * parameters, so they can be changed without a rebuild
+ */
+struct SceneVariant {
+  std::string name;           // the name on the command line e.g. kaleido
+  std::string define;         // selects the scene file in kernels/kernels.cl e.g. SCENE_KALEIDO
+  int maxRaymarchSteps;       // the maximal count of march steps per ray
+  float raymarchPrecision;    // the distance at which a ray hits the surface
+  bool shadows;               // the hit points are shadowed with soft shadows
+  bool ao;                    // the hit points are darkened with ambient occlusion
+  SceneParams params;         // the parameters the scene starts with
+
+  /**
+   * returns the build options which define the scene, the constants and the feature toggles
+   */
+  std::string buildOptions() const;
+};
+
+namespace scenes {
+/**
+ * returns all scenes, the first one is the default scene
+ */
+extern const std::vector<SceneVariant> &all();
+
+/**
+ * returns the scene with the given name or nullptr if there is none
+ */
+extern const SceneVariant *find(const std::string &name);
+} // namespace scenes
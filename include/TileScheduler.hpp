@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * a pool of persistent worker threads, which processes tiles with work stealing: every worker gets
+ * a contiguous range of tiles in its own queue and steals from the back of the other queues, as
+ * soon as its own queue is empty
+ */
+class TileScheduler {
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<size_t> tiles;
+  };
+
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::function<void(size_t)> task; // the task of the current run, gets the tile index
+  std::mutex mutex;
+  std::condition_variable startCondition;
+  std::condition_variable doneCondition;
+  size_t generation;    // is incremented with every run, so the workers know when to start
+  size_t activeWorkers; // the count of workers which haven't finished the current run
+  bool quit;
+
+  /**
+   * pops a tile from the own queue or steals one from another worker
+   *
+   * @return false if there are no tiles left
+   */
+  bool popTile(size_t worker, size_t &tile);
+
+  void workerLoop(size_t worker);
+
+public:
+  /**
+   * @param threadCount the count of worker threads, 0 means one per hardware thread
+   */
+  TileScheduler(size_t threadCount = 0);
+
+  ~TileScheduler();
+
+  size_t getThreadCount() const;
+
+  /**
+   * calls 'task' for every tile in [0, tileCount) on the worker threads and blocks until all
+   * tiles are done
+   */
+  void run(size_t tileCount, const std::function<void(size_t)> &task);
+};
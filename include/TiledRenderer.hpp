@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CLRenderer.hpp"
+#include "ImageIO.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * renders images which don't fit into the device memory: a renderer of the size of one tile
+ * renders the image tile by tile and every finished tile is streamed into a memory mapped image
+ * file, so the memory usage doesn't depend on the size of the image
+ */
+class TiledRenderer {
+  /**
+   * a finished tile whose raw image is read back and written to the image file
+   */
+  struct PendingTile {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+    std::vector<float> pixels; // the raw image of the tile, is valid as soon as 'read' is done
+    cl::Event read;
+  };
+
+  std::unique_ptr<CLRenderer> renderer; // renders one tile, its size is the tile size
+  size_t width;                         // the width of the whole image
+  size_t height;                        // the height of the whole image
+  size_t tileSize;                      // the width and height of the tiles
+  glm::mat4 vMatrix;                    // the view matrix of the whole image
+  float fov;                            // the fov of the whole image
+
+  /**
+   * sets the view of the tile renderer to the given tile, the view frustum of the whole image is
+   * sheared and narrowed, so the camera rays of the tile are the same as in the whole image
+   */
+  void setTileView(size_t x, size_t y, size_t tileWidth, size_t tileHeight);
+
+public:
+  /**
+   * initializes the renderer of the tiles
+   *
+   * @param width the width of the whole image
+   * @param height the height of the whole image
+   * @param tileSize the width and height of the tiles, only one tile is in device memory
+   * @param kernelname the name of the render kernel e.g. raymarch
+   * @param sourceFilename the filename of the opencl file
+   * @param buildOptions additional options for building the program e.g. -D SCENE_KALEIDO
+   * @param deviceIndex the index of the device in the list of all devices of all platforms
+   */
+  TiledRenderer(size_t width, size_t height, size_t tileSize, const std::string &kernelname,
+                const std::string &sourceFilename, const std::string &buildOptions = "",
+                size_t deviceIndex = 0);
+
+  /**
+   * renders all tiles with 'samplesPerPixel' samples per pixel into the image, the tiles are
+   * written to the image on another thread while the device renders the next tile
+   *
+   * @param samplesPerLaunch the count of samples per pixel rendered with a single launch
+   */
+  void render(imageio::MappedImage &image, size_t samplesPerPixel, size_t samplesPerLaunch);
+
+  void setVMatrix(glm::mat4 m);
+
+  void setFov(float fov);
+
+  /**
+   * returns the renderer of the tiles, e.g. for enabling adaptive sampling, the cone prepass and
+   * the temporal reprojection aren't supported by the sheared views of the tiles
+   */
+  CLRenderer &getTileRenderer();
+};
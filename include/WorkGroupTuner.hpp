@@ -0,0 +1,103 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+
+#include "ProgramCache.hpp"
+#include <CL/cl.hpp>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * finds the fastest work-group size of a 2D kernel on a device: the first passes try the candidate
+ * sizes in turns and their launches are timed with profiling events, every candidate is timed on
+ * whole passes, so all of them render the same rows and the winner doesn't depend on the content
+ * of the rows, the winner is stored in a table in the cache directory, which is keyed by the
+ * device and the kernel, so later starts use it right away, the queue of the launches needs
+ * CL_QUEUE_PROFILING_ENABLE
+ */
+class WorkGroupTuner {
+  /**
+   * a launch whose time isn't known yet
+   */
+  struct PendingLaunch {
+    size_t pass;    // the pass the launch belongs to, its candidate is 'pass % candidates.size()'
+    size_t items;   // the count of work-items that were inside of the launched range
+    bool discarded; // the pass was interrupted, so it didn't render all of its rows
+    cl::Event event;
+  };
+
+  std::string tableFilename;              // the table of all winners, empty disables the table
+  std::string key;                        // the key of the kernel in the table
+  std::vector<cl::size_t<2>> candidates;  // the work-group sizes which fit on the device
+  std::vector<std::vector<double>> times; // the nanoseconds per work-item of the timed passes
+  std::deque<PendingLaunch> pending;      // the launches in the order of submission
+  size_t passCount;                       // the index of the current pass while tuning
+  size_t current;                         // the candidate of the last launch arguments
+  size_t currentItems;                    // the count of work-items of the last arguments
+  size_t timedPass;                       // the pass whose completed launches are summed up
+  double timedNanoseconds;                // the time of the completed launches of 'timedPass'
+  size_t timedItems;                      // the work-items of the completed launches of it
+  bool timedDiscarded;                    // 'timedPass' was interrupted
+  bool tuned;                             // 'current' is the winner
+
+  /**
+   * adds the time per work-item of 'timedPass' to its candidate and starts summing up 'pass'
+   */
+  void finishTimedPass(size_t pass);
+
+  /**
+   * reads the times of the completed launches and chooses the winner as soon as every candidate
+   * was timed on enough passes
+   */
+  void collectTimes();
+
+  bool loadWinner();
+
+  void storeWinner() const;
+
+public:
+  static const size_t PASSES_PER_CANDIDATE = 4;
+
+  /**
+   * all candidates have a height of at most 'maxHeight', e.g. for kernels whose launches are
+   * split into ranges of rows
+   *
+   * @param kernel the kernel, which is only used for querying its maximal work-group size
+   * @param programHash identifies the source and the build options of the program
+   * @param directory the directory of the table, if it is empty the winner isn't stored
+   */
+  WorkGroupTuner(const cl::Kernel &kernel, const cl::Device &device, uint64_t programHash,
+                 size_t maxHeight = 8,
+                 const std::string &directory = ProgramCache::defaultDirectory());
+
+  /**
+   * begins a pass, the launches until the next pass render the rows of the pass with the same
+   * candidate, e.g. all bands of an image or a single launch over the whole image
+   *
+   * @param previousComplete false if the previous pass was interrupted before all of its rows were
+   * rendered, its time isn't comparable to the other passes then
+   */
+  void beginPass(bool previousComplete = true);
+
+  /**
+   * returns the launch arguments for 'width' x 'height' work-items beginning at 'offset', the
+   * global size is rounded up to a multiple of the work-group size of the launch, which is the
+   * winner or the candidate of the current pass while tuning
+   */
+  cl::EnqueueArgs launchArgs(cl::CommandQueue &queue, const cl::NDRange &offset, size_t width,
+                             size_t height);
+
+  /**
+   * times the launch, which has to use the arguments of the last call of 'launchArgs'
+   */
+  void addLaunch(const cl::Event &launch);
+
+  bool isTuned() const;
+
+  /**
+   * returns the winner or the candidate of the last launch arguments as width and height
+   */
+  cl::size_t<2> getLocalSize() const;
+};
@@ -5,6 +5,8 @@
 typedef struct Ray {
   float3 origin;
   float3 dir;
+  float2 cone; // x the radius of the footprint of the pixel at the origin, y its growth per unit
+               // of distance, the march tolerates distance estimates below the footprint
 } Ray;
 
 typedef struct {
@@ -15,6 +17,30 @@ typedef struct {
   float4 m[4];
 } float4x4;
 
+// the parameters of the scenes, which the host computes once and uploads into a constant buffer,
+// so they can be changed without rebuilding the program, the layout has to match
+// cl_scene_params in include/SceneParams.hpp
+typedef struct {
+  float4x4 kifsTransform;    // the transposed transform of one iteration of the kaleido scene
+  float4 light;              // xyz the position of the light
+  float4 lightColor;
+  float4 matColor;
+  float4 backgroundColor;
+  float4 mengerOffset;
+  float kifsInvScale;        // the distance scale of one kaleido iteration
+  float kifsLodFactor;       // 1 / log2 of the scale of the kaleido iterations
+  float kifsBoundingRadius;  // the radius of the bounding sphere of the kaleido scene
+  float mengerScale;
+  float mengerInvScale;      // the distance scale of one menger iteration
+  float mengerLodFactor;     // 1 / log2(mengerScale)
+  float shadowSoftness;
+  float shadowMinLight;      // the fraction of the light that reaches fully shadowed points
+  float footprintEpsilon;    // the fraction of the pixel footprint the march stops at
+  float relaxation;          // the factor of the over-relaxed steps of the march, 1 disables it
+  int kifsIterations;
+  int mengerIterations;
+} SceneParams;
+
 //------------------------------------------------------------------------------
 // Matrix operations
 //------------------------------------------------------------------------------
@@ -100,26 +126,162 @@ float4x4 transpose4x4constant(constant float4x4 *M) {
   return retVal;
 }
 
+// relative luminance of a linear rgb color
+inline float luminance(const float3 color) {
+  return dot(color, (float3)(0.2126f, 0.7152f, 0.0722f));
+}
+
 //------------------------------------------------------------------------------
-// Random number generator
-// combined Tausworthe and LCG generator
+// Dual numbers
 //------------------------------------------------------------------------------
 
-inline uint tausStep(uint* z, int S1, int S2, int S3, uint M) {
-  uint b=((((*z) << S1) ^ (*z)) >> S2);
-  return *z = ((((*z) & M) << S3) ^ b);
+// a position in a distance estimator together with its derivatives with respect to the x, y and
+// z of the evaluated point, so the gradient is computed in the same pass as the distance
+typedef struct {
+  float3 val;
+  float3 dx; // the derivative of 'val' with respect to x
+  float3 dy; // the derivative of 'val' with respect to y
+  float3 dz; // the derivative of 'val' with respect to z
+} dual3;
+
+// a distance together with its gradient
+typedef struct {
+  float val;
+  float3 grad;
+} dual;
+
+// the evaluated point itself, whose derivatives are the unit vectors
+inline dual3 dual3Point(const float3 p) {
+  const dual3 retVal = {p, (float3)(1.0f, 0.0f, 0.0f), (float3)(0.0f, 1.0f, 0.0f),
+                        (float3)(0.0f, 0.0f, 1.0f)};
+  return retVal;
 }
 
-inline uint lcgStep(uint* z, uint A, uint C) {
-  return *z=(A*(*z)+C);
+inline dual3 dual3Scale(dual3 a, const float s) {
+  a.val *= s;
+  a.dx *= s;
+  a.dy *= s;
+  a.dz *= s;
+  return a;
 }
-inline float rand(uint4* z) {
-  // Combined period is lcm(p1,p2,p3,p4)~ 2^121
-  return 2.3283064365387e-10f * (float)(              // Periods
-      tausStep((uint*)((uint*)z+0), 13, 19, 12, 4294967294) ^  // p1=2^31-1
-      tausStep((uint*)((uint*)z+1), 2, 25, 4, 4294967288) ^    // p2=2^30-1
-      tausStep((uint*)((uint*)z+2), 3, 11, 17, 4294967280) ^   // p3=2^28-1
-      lcgStep((uint*)((uint*)z+3), 1664525, 1013904223)        // p4=2^32
-      );
+
+inline dual3 dual3Add(dual3 a, const float3 b) {
+  a.val += b;
+  return a;
 }
 
+inline dual3 dual3Fabs(dual3 a) {
+  const float3 s = copysign((float3)(1.0f), a.val);
+  a.val = fabs(a.val);
+  a.dx *= s;
+  a.dy *= s;
+  a.dz *= s;
+  return a;
+}
+
+// transforms (a, w) by the matrix, the translation only changes the value
+inline dual3 dual3MatMul4x4constant(constant float4x4 *M, dual3 a, const float w) {
+  a.val = matMul4x4constant(M, (float4)(a.val, w)).xyz;
+  a.dx = matMul4x4constant(M, (float4)(a.dx, 0.0f)).xyz;
+  a.dy = matMul4x4constant(M, (float4)(a.dy, 0.0f)).xyz;
+  a.dz = matMul4x4constant(M, (float4)(a.dz, 0.0f)).xyz;
+  return a;
+}
+
+// the component 'c' (0, 1 or 2) of 'a'
+inline dual dual3Component(const dual3 a, const int c) {
+  const float3 e = (float3)(c == 0, c == 1, c == 2);
+  const dual retVal = {dot(a.val, e), (float3)(dot(a.dx, e), dot(a.dy, e), dot(a.dz, e))};
+  return retVal;
+}
+
+inline dual dual3Length(const dual3 a) {
+  const float len = length(a.val);
+  const dual retVal = {len, (float3)(dot(a.val, a.dx), dot(a.val, a.dy), dot(a.val, a.dz)) / len};
+  return retVal;
+}
+
+// e.g. dual3Swizzle(p, xy, yx) swaps the x and y of 'p' and its derivatives
+#define dual3Swizzle(a, dst, src)                                                                  \
+  do {                                                                                             \
+    (a).val.dst = (a).val.src;                                                                     \
+    (a).dx.dst = (a).dx.src;                                                                       \
+    (a).dy.dst = (a).dy.src;                                                                       \
+    (a).dz.dst = (a).dz.src;                                                                       \
+  } while (0)
+
+//------------------------------------------------------------------------------
+// Camera
+//------------------------------------------------------------------------------
+
+#define CAMERA_SAMPLE_DIMENSIONS 2 // the count of dimensions 'generateCameraRay' uses
+
+// generates a primary ray through the pixel (x, y), which is jittered with a tent filter
+// 'filterWidth' is the radius of the tent filter in pixels
+Ray generateCameraRay(const int x, const int y, const int width, const int height, const float fov,
+                      constant float3x4* vMatrix, const float filterWidth, Sampler* sampler) {
+  const float r1 = 2.0f*sampleNext(sampler);
+  const float dx = r1<1.0f ? sqrt(r1)-1.0f: 1.0f-sqrt(2.0f-r1);
+  const float r2 = 2.0f*sampleNext(sampler);
+  const float dy = r2<1.0f ? sqrt(r2)-1.0f: 1.0f-sqrt(2.0f-r2);
+  const float invWidth = 1.0f / (float)width;
+  const float u = ((float)x + 0.5f + dx*filterWidth) * invWidth * 2.0f - 1.0f;
+  const float v = ((float)y + 0.5f + dy*filterWidth) * invWidth * 2.0f - (float)height/(float)width;
+  // normalized after the transformation, so the view matrix may also shear the view frustum
+  // (e.g. for a tile of a larger image)
+  const float3 planePoint = (float3)(u,v, fmin(-fov, -0.0001f));
+  const float3 dir = normalize(matMul3x4NoTrans(vMatrix, planePoint));
+  // the footprint is a cone with the radius of half a pixel at the image plane
+  const Ray ray = {matMul3x4(vMatrix, (float4)(0.0f, 0.0f, 0.0f, 1.0f)).xyz, dir,
+                   (float2)(0.0f, invWidth / length(planePoint))};
+  return ray;
+}
+
+// the radius of the footprint of the pixel of 'ray' at the distance 't'
+inline float rayFootprint(const Ray ray, const float t) {
+  return ray.cone.x + ray.cone.y * t;
+}
+
+//------------------------------------------------------------------------------
+// Bounding volumes
+//------------------------------------------------------------------------------
+
+// the range of the ray parameter inside of the sphere, x > y if the ray misses it
+inline float2 intersectSphere(const Ray ray, const float3 center, const float radius) {
+  const float3 oc = ray.origin - center;
+  const float b = dot(oc, ray.dir);
+  const float h = b*b - dot(oc, oc) + radius*radius;
+  if (h < 0.0f)
+    return (float2)(1.0f, 0.0f);
+  const float sq = sqrt(h);
+  return (float2)(-b - sq, -b + sq);
+}
+
+// the range of the ray parameter inside of the axis aligned box, x > y if the ray misses it, the
+// slabs of zero components of the direction are infinite (or NaN, which fmin and fmax ignore)
+inline float2 intersectBox(const Ray ray, const float3 boxMin, const float3 boxMax) {
+  const float3 invDir = 1.0f / ray.dir;
+  const float3 t0 = (boxMin - ray.origin) * invDir;
+  const float3 t1 = (boxMax - ray.origin) * invDir;
+  const float3 tNear = fmin(t0, t1);
+  const float3 tFar = fmax(t0, t1);
+  return (float2)(fmax(fmax(tNear.x, tNear.y), tNear.z), fmin(fmin(tFar.x, tFar.y), tFar.z));
+}
+
+//------------------------------------------------------------------------------
+// Level of detail
+//------------------------------------------------------------------------------
+
+#ifndef LOD_EXTRA_ITERATIONS
+#define LOD_EXTRA_ITERATIONS 2 // the iterations beyond the footprint, which hide the transitions
+#endif
+
+// the iteration budget of a fractal whose detail shrinks by a constant scale per iteration, the
+// detail of the last iteration is about the size of 'footprint', 'lodFactor' is 1 / log2(scale),
+// a footprint of 0 gets all 'maxIterations'
+inline int lodIterations(const float footprint, const float lodFactor, const int maxIterations) {
+  if (footprint <= 0.0f)
+    return maxIterations;
+  const int iterations = (int)ceil(-log2(footprint) * lodFactor) + LOD_EXTRA_ITERATIONS;
+  return clamp(iterations, 1, maxIterations);
+}
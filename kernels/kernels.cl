@@ -1,6 +1,18 @@
 
+// the sampler can be chosen with the build option -D SAMPLER_SOBOL, -D SAMPLER_R2 or
+// -D SAMPLER_BLUE_NOISE
+#include "sampler.cl"
+
 #include "common.cl"
 
 #include "tonemap.cl"
 
+// the scene can be chosen with the build option -D SCENE_KALEIDO or -D SCENE_MENGER
+#if defined(SCENE_KALEIDO)
+#include "raymarch_kaleido.cl"
+#else
 #include "raymarch_menger.cl"
+#endif
+
+// the render kernels, which use the functions of the scene
+#include "render.cl"
@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+// Marching
+//------------------------------------------------------------------------------
+
+// the sphere tracing of the scenes, 'DE', 'DEIterations', 'sceneBounds', 'sceneExtent',
+// MAX_SCENE_BOUNDS, MAX_RAYMARCH_STEPS and RAYMARCH_PRECISION have to be defined before this file
+// is included, the distance estimates use the iteration budget of the footprint at the current
+// point, the rays are only marched inside of the bounding volume of the scene
+
+// the distance estimate at which 'ray' hits the surface at the distance 't', it is the footprint
+// of the pixel scaled by 'scene->footprintEpsilon', so distant hits aren't refined below the size
+// of a pixel, but it is at least RAYMARCH_PRECISION
+inline float hitEpsilon(const Ray ray, const float t, constant SceneParams* scene) {
+  return fmax(RAYMARCH_PRECISION, scene->footprintEpsilon * rayFootprint(ray, t));
+}
+
+// the range of 'ray' beginning at 'tmin' inside of the bounding volume of the scene and
+// MAX_SCENE_BOUNDS, x > y if there is nothing to march
+inline float2 marchRange(const Ray ray, const float tmin, constant SceneParams* scene) {
+  const float2 bounds = sceneBounds(ray, scene);
+  return (float2)(fmax(tmin, bounds.x), fmin(MAX_SCENE_BOUNDS, bounds.y));
+}
+
+// the scenes that are shaded by the count of march steps set SCENE_STEP_SHADED, their camera rays
+// are only clipped at the exit of the bounding volume, because the steps in front of it are part
+// of the count
+#ifndef SCENE_STEP_SHADED
+#define SCENE_STEP_SHADED 0
+#endif
+
+// the range of the camera ray 'ray' beginning at 'tmin', see 'marchRange'
+inline float2 cameraMarchRange(const Ray ray, const float tmin, constant SceneParams* scene) {
+  float2 range = marchRange(ray, tmin, scene);
+#if SCENE_STEP_SHADED
+  if (range.x <= range.y)
+    range.x = tmin;
+#endif
+  return range;
+}
+
+// the distance field of the scene baked by 'bakeDistanceField' (see include/DistanceField.hpp),
+// the grid of 'resolution'^3 cells fills the box of 'sceneExtent', 'resolution' is 0 without a
+// field
+typedef struct {
+  global const float* distances;
+  int resolution;
+} DistanceField;
+
+// a lower bound of the distance from 'pos' to the surface taken from the baked field, it is 0 if
+// the point is outside of the field (the comparisons also fail for an infinite extent) or if the
+// cell is so close to the surface, that the step wouldn't even cross half of the cell
+inline float fieldDistance(const DistanceField field, const float3 pos,
+                           constant SceneParams* scene) {
+  if (field.resolution == 0)
+    return 0.0f;
+  const float3 extent = sceneExtent(scene);
+  const float3 cell = floor((pos + extent) * ((float)field.resolution * 0.5f / extent));
+  if (!(all(cell >= 0.0f) && all(cell < (float)field.resolution)))
+    return 0.0f;
+  const int3 index = convert_int3(cell);
+  const float distance =
+      field.distances[(index.z*field.resolution + index.y)*field.resolution + index.x];
+  return distance > length(extent) / (float)field.resolution ? distance : 0.0f;
+}
+
+// the state of an over-relaxed sphere tracing (Keinert et al., "Enhanced Sphere Tracing"): the
+// steps are 'omega' times the distance estimate, which is safe as long as the empty spheres of two
+// consecutive points overlap
+typedef struct {
+  float t;          // the distance along the ray
+  float tmax;       // the ray leaves the bounding volume of the scene at this distance
+  float omega;      // the relaxation factor, it falls back to 1 after the first failed step
+  float lastRadius; // the distance estimate of the previous point
+  float stepLength; // the length of the previous step
+} MarchState;
+
+// 'range' is the range of the ray that is marched, see 'marchRange'
+inline MarchState marchInit(const float2 range, constant SceneParams* scene) {
+  const MarchState state = {range.x, range.y, scene->relaxation, 0.0f, 0.0f};
+  return state;
+}
+
+// evaluates the distance estimate at the current point and advances the march, returns true as
+// soon as the ray hits the surface or leaves the bounding volume, the point after a relaxed step
+// behind the bounding volume is evaluated nevertheless, because the step may have skipped it, far
+// from the surface the lower bound of the baked field replaces the distance estimate
+inline bool marchStep(const Ray ray, MarchState* state, constant SceneParams* scene,
+                      const DistanceField field) {
+  const float3 pos = ray.origin + ray.dir*state->t;
+  const float epsilon = hitEpsilon(ray, state->t, scene);
+  float radius = fieldDistance(field, pos, scene);
+  if (radius < epsilon)
+    radius = DE(pos, DEIterations(rayFootprint(ray, state->t), scene), scene);
+  // the empty spheres don't overlap, so the relaxed step may have skipped the surface, it is
+  // replaced by the plain step from the previous point and the rest of the march isn't relaxed
+  if (state->omega > 1.0f && radius + state->lastRadius < state->stepLength) {
+    state->t += state->lastRadius - state->stepLength;
+    state->stepLength = state->lastRadius;
+    state->omega = 1.0f;
+    return false;
+  }
+  if (radius < epsilon || state->t > state->tmax)
+    return true;
+  state->lastRadius = radius;
+  state->stepLength = state->omega * radius;
+  state->t += state->stepLength;
+  return false;
+}
+
+// 'start' is the distance and the count of steps the march continues from, e.g. from the cone
+// prepass, it is (0, 0) to march from the origin of the ray
+int march(const Ray ray, const float2 start, constant SceneParams* scene,
+          const DistanceField field, float* t) {
+  MarchState state =
+      marchInit(cameraMarchRange(ray, fmax(RAYMARCH_PRECISION*3.0f, start.x), scene), scene);
+  *t = state.t;
+  // the ray misses the bounding volume, so there is not a single step to march
+  if (state.t > state.tmax)
+    return -1;
+  int steps = (int)start.y - 1;
+  for(int i = (int)start.y; i < MAX_RAYMARCH_STEPS; ++i) {
+    if (marchStep(ray, &state, scene, field))
+      break;
+    steps = i;
+  }
+  *t = state.t;
+  if( state.t > state.tmax)
+    return -1;
+  return steps;
+}
+
+// the shadow ray starts at the footprint of the hit point ('toLightray.cone.x'), it is blocked as
+// soon as the distance estimate falls below the same tolerance as the one of the camera ray, it is
+// unshadowed as soon as it leaves the bounding volume, the march stops as soon as the penumbra
+// factor reaches 'scene->shadowMinLight', because the light never falls below it
+float softshadow(const Ray toLightray, const float mint, const float maxt, const float k,
+                 constant SceneParams* scene ) {
+  const float2 range = marchRange(toLightray, mint, scene);
+  const float tmax = fmin(maxt, range.y);
+  float res = 1.0;
+  int steps = 0;
+  for( float t=range.x; t < tmax && steps < MAX_RAYMARCH_STEPS; ) {
+    float h = DE(toLightray.origin + toLightray.dir*t,
+                 DEIterations(rayFootprint(toLightray, t), scene), scene);
+    if( h < hitEpsilon(toLightray, t, scene) )
+      return 0.0;
+    res = min( res, k*h/t );
+    if( res <= scene->shadowMinLight )
+      return res;
+    t += h;
+    steps++;
+  }
+  return res;
+}
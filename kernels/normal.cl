@@ -0,0 +1,36 @@
+//------------------------------------------------------------------------------
+// Normals
+//------------------------------------------------------------------------------
+
+// the normal estimators, every scene defines the default 'NORMAL_ESTIMATOR' unless it is set with
+// a build option e.g. -D NORMAL_ESTIMATOR=NORMAL_TETRAHEDRAL, 'DE' and for NORMAL_DUAL also
+// 'DEDual' have to be defined before this file is included, 'iterations' is the iteration budget
+// of the hit point (see 'DEIterations')
+#define NORMAL_CENTRAL 0     // central differences, 6 evaluations of 'DE'
+#define NORMAL_TETRAHEDRAL 1 // differences at the corners of a tetrahedron, 4 evaluations of 'DE'
+#define NORMAL_DUAL 2        // the gradient of a single evaluation of 'DEDual'
+
+#if NORMAL_ESTIMATOR == NORMAL_DUAL
+float3 calcNormal( const float3 pos, const int iterations, constant SceneParams* scene ) {
+  return normalize(DEDual(dual3Point(pos), iterations, scene).grad);
+}
+#elif NORMAL_ESTIMATOR == NORMAL_TETRAHEDRAL
+float3 calcNormal( const float3 pos, const int iterations, constant SceneParams* scene ) {
+  const float2 k = (float2)(1.0f, -1.0f);
+  return normalize(k.xyy * DE(pos + k.xyy * RAYMARCH_PRECISION, iterations, scene) +
+                   k.yyx * DE(pos + k.yyx * RAYMARCH_PRECISION, iterations, scene) +
+                   k.yxy * DE(pos + k.yxy * RAYMARCH_PRECISION, iterations, scene) +
+                   k.xxx * DE(pos + k.xxx * RAYMARCH_PRECISION, iterations, scene));
+}
+#else
+float3 calcNormal( const float3 pos, const int iterations, constant SceneParams* scene ) {
+  const float3 epsX = (float3)(RAYMARCH_PRECISION , 0.0f, 0.0f);
+  const float3 epsY = (float3)(0.0f, RAYMARCH_PRECISION, 0.0f);
+  const float3 epsZ = (float3)(0.0f, 0.0f, RAYMARCH_PRECISION);
+  float3 n = (float3)(
+      DE(pos+epsX, iterations, scene) - DE(pos-epsX, iterations, scene),
+      DE(pos+epsY, iterations, scene) - DE(pos-epsY, iterations, scene),
+      DE(pos+epsZ, iterations, scene) - DE(pos-epsZ, iterations, scene));
+  return normalize(n);
+}
+#endif
@@ -1,162 +1,163 @@
 //------------------------------------------------------------------------------
 // Constants
+// the scene registry (see include/SceneRegistry.hpp) bakes the constants with #ifndef into the
+// program with -D options, the defaults are used if the program is built without them
 //------------------------------------------------------------------------------
 #define MAX_SCENE_BOUNDS 100000.0f
+#ifndef MAX_RAYMARCH_STEPS
 #define MAX_RAYMARCH_STEPS 250
+#endif
+#ifndef RAYMARCH_PRECISION
 #define RAYMARCH_PRECISION 0.0000001f
-#define KIFS_ITERATIONS 40
-
-#define light ((float3)(2.0,-4.0,-9.0))
-#define matColor ((float3)(1.0,1.0,1.0))
-#define lightColor (19.0f * (float3)(1.0,0.9,0.8))
-#define cameraLightColor (0.01f*(float3)(0.1,0.1,0.15))
-#define backgroundColor ((float3)(0.0,0.0,0.0))
-
-float4x4 calc_transform(float3 offset, float3 axis, float angle, float scale) {
-  angle *= radians(1.0f);
+#endif
+#define FILTER_WIDTH 1.0f // the radius of the tent filter in pixels
+#ifndef SCENE_SHADOWS
+#define SCENE_SHADOWS 1 // the hit points are shadowed with 'softshadow'
+#endif
+#ifndef SCENE_AO
+#define SCENE_AO 1 // the hit points are darkened with 'aoFactor'
+#endif
+#define KIFS_BAILOUT 1000.0f // the iterations stop as soon as the point is this far away
+
+// the transform of the iterations and the light are in 'scene', see SceneParams::toCL, the point
+// only moves further away after it passed KIFS_BAILOUT, so the distance hardly changes anymore
+float DEKIFS(float3 p, float s, const int iterations, constant SceneParams* scene) {
+  p /= s;
 
-  float c = cos(angle);
-  float s = sin(angle);
+  float distanceScale = 1.0f;
+  for (int i = 0; i < iterations; i++) {
+    p = fabs(p);
 
-  float3 t = (1.0f-c) * axis;
+    // apply transform
+    p = matMul4x4constant(&scene->kifsTransform, (float4)(p.x,p.y,p.z, 0.3f)).xyz;
+    distanceScale *= scene->kifsInvScale;
+    if (dot(p, p) > KIFS_BAILOUT*KIFS_BAILOUT)
+      break;
+  }
+  return ((fast_length(p) - 1.0f) * distanceScale) * s;
+}
 
-  float4x4 retVal;
-  retVal.m[0] = (float4)(c + t.x * axis.x, t.y * axis.x - s * axis.z, t.z * axis.x + s * axis.y, 0.0f) * scale;
-  retVal.m[1] = (float4)(t.x * axis.y + s * axis.z, (c + t.y * axis.y), t.z * axis.y - s * axis.x, 0.0f) * scale;
-  retVal.m[2] = (float4)(t.x * axis.z - s * axis.y, t.y * axis.z + s * axis.x, c + t.z * axis.z, 0.0f) * scale;
-  retVal.m[3] = (float4)(offset, 1.0f);
-  return retVal;
+inline float DE(const float3 pos, const int iterations, constant SceneParams* scene) {
+  return DEKIFS(pos, 1.0f, iterations, scene);
 }
-float DEKIFS(float3 p, float s) {
-  const float4x4 mtmp = calc_transform((float3)(-0.4f, -0.9f, -0.49f),normalize((float3)(1.0f, 1.0f, 2.1f)), 40.0f, 1.5f);
-  const float4x4 m1 = transpose4x4(&mtmp);
-  p /= s;
 
-  for (int i = 0; i < KIFS_ITERATIONS; i++) {
-    p = fabs(p);
+// 'DEKIFS' with dual numbers, the gradient is the normal of the surface
+dual DEKIFSDual(dual3 p, float s, const int iterations, constant SceneParams* scene) {
+  p = dual3Scale(p, 1.0f / s);
+
+  float distanceScale = 1.0f;
+  for (int i = 0; i < iterations; i++) {
+    p = dual3Fabs(p);
 
     // apply transform
-    p = matMul4x4(&m1, (float4)(p.x,p.y,p.z, 0.3f)).xyz;
+    p = dual3MatMul4x4constant(&scene->kifsTransform, p, 0.3f);
+    distanceScale *= scene->kifsInvScale;
+    if (dot(p.val, p.val) > KIFS_BAILOUT*KIFS_BAILOUT)
+      break;
   }
-  return ((fast_length(p) - 1.0f) * (pow(1.5f, -(float)(KIFS_ITERATIONS)))) * s;
+  dual d = dual3Length(p);
+  d.val = (d.val - 1.0f) * distanceScale * s;
+  d.grad *= distanceScale;
+  return d;
 }
 
-inline float DE(const float3 pos) {
-  return DEKIFS(pos, 1.0f);
+inline dual DEDual(const dual3 pos, const int iterations, constant SceneParams* scene) {
+  return DEKIFSDual(pos, 1.0f, iterations, scene);
 }
 
-float3 calcNormal( const float3 pos ) {
-  const float3 epsX = (float3)(RAYMARCH_PRECISION , 0.0f, 0.0f);
-  const float3 epsY = (float3)(0.0f, RAYMARCH_PRECISION, 0.0f);
-  const float3 epsZ = (float3)(0.0f, 0.0f, RAYMARCH_PRECISION);
-  int tmpMatID;
-  float3 n = (float3)(
-      DE(pos+epsX) - DE(pos-epsX),
-      DE(pos+epsY) - DE(pos-epsY),
-      DE(pos+epsZ) - DE(pos-epsZ));
-  return normalize(n);
+// every iteration shrinks the detail by 'kifsScale'
+inline int DEIterations(const float footprint, constant SceneParams* scene) {
+  return lodIterations(footprint, scene->kifsLodFactor, scene->kifsIterations);
 }
 
-int march(const Ray ray, float* t) {
-  const float tmin = RAYMARCH_PRECISION*3.0f;
-  float _t = tmin;
-  int steps = -1;
-  for(int i = 0; i < MAX_RAYMARCH_STEPS; ++i) {
-    float dis = DE(ray.origin+ray.dir*_t);
-    if( dis < RAYMARCH_PRECISION || _t > MAX_SCENE_BOUNDS)
-      break;
-    _t += dis;
-    steps = i;
-  }
-  *t = _t;
-  if( _t > MAX_SCENE_BOUNDS)
-    return -1;
-  return steps;
+// the points outside of the bounding sphere only move further away with every iteration, see
+// SceneParams::toCL
+inline float2 sceneBounds(const Ray ray, constant SceneParams* scene) {
+  return intersectSphere(ray, (float3)(0.0f), scene->kifsBoundingRadius);
+}
+
+// the box around the bounding sphere
+inline float3 sceneExtent(constant SceneParams* scene) {
+  return (float3)(scene->kifsBoundingRadius);
 }
 
-float calcAO(float3 pos, float3 nor, uint4* randState )
+// the iterations of the lower bounds of the baked distance field and the cone prepass, the set of
+// fewer iterations only contains the set of more iterations if 0.3*|kifsOffset|/(kifsScale - 1)
+// <= 1, which depends on the parameters, so the bounds use the full budget
+inline int boundIterations(const float radius, constant SceneParams* scene) {
+  return scene->kifsIterations;
+}
+
+// a single pass of 'DEKIFS' is cheaper than the 6 evaluations of the central differences
+#ifndef NORMAL_ESTIMATOR
+#define NORMAL_ESTIMATOR NORMAL_DUAL
+#endif
+#include "normal.cl"
+
+// the march and the soft shadows with the tolerances of the pixel footprint
+#include "march.cl"
+
+// the squared mean below isn't linear in the probes, so fewer probes per sample would converge to
+// a darker image, every sample keeps all 8
+float calcAO(float3 pos, float3 nor, const int iterations, constant SceneParams* scene,
+             Sampler* sampler )
 {
   float totao = 0.0f;
   for(int aoi=0; aoi<8; aoi++) {
-    float3 aopos = -1.0f+2.0f*(float3)(rand(randState), rand(randState), rand(randState));
+    float3 aopos = -1.0f+2.0f*(float3)(sampleNext(sampler), sampleNext(sampler), sampleNext(sampler));
     aopos *= sign( dot(aopos,nor) );
     aopos = pos + nor*0.01f + aopos*0.04f;
-    float dd = clamp( DE(aopos)*4.0f, 0.0f, 1.0f );
+    float dd = clamp( DE(aopos, iterations, scene)*4.0f, 0.0f, 1.0f );
     totao += dd;
   }
   totao /= 8.0f;
   return clamp( totao*totao*50.0f, 0.0f, 1.0f );
 }
 
-float softshadow(const Ray toLightray, const float mint, const float maxt, const float k ) {
-  float res = 1.0;
-  int steps = 0;
-  for( float t=mint; t < maxt && steps < MAX_RAYMARCH_STEPS; ) {
-    float h = DE(toLightray.origin + toLightray.dir*t);
-    if( h < RAYMARCH_PRECISION )
-      return 0.0;
-    res = min( res, k*h/t );
-    t += h;
-    steps++;
-  }
-  return res;
+// the ambient occlusion of the hit point, which the color of the hit point is multiplied with,
+// 'footprint' is the radius of the footprint of the pixel at the hit point
+inline float aoFactor(float3 pos, float3 nor, const float footprint, constant SceneParams* scene,
+                      Sampler* sampler) {
+  return pow(calcAO(pos, nor, DEIterations(footprint, scene), scene, sampler), 1.0f/2.2f);
+}
+
+// the color of the hit point of 'ray' at the distance 't' without shadows and ambient occlusion,
+// 'normal' and 'shadowRay' are set for 'aoFactor' and 'softshadow'
+inline float3 shadeHit(const Ray ray, const float t, const int steps,
+                       constant SceneParams* scene, float3* normal, Ray* shadowRay) {
+  // fixed ligthning
+  const float3 pos = ray.origin + ray.dir * (t);
+  *normal = calcNormal(pos, DEIterations(rayFootprint(ray, t), scene), scene);
+  float3 lPos = scene->light.xyz - pos;
+  float llen = length(lPos);
+  float3 lPosNorm = normalize(lPos);
+  shadowRay->origin = pos;
+  shadowRay->dir = lPosNorm;
+  // the shadow ray keeps the footprint of the pixel at the hit point
+  shadowRay->cone = (float2)(rayFootprint(ray, t), 0.0f);
+
+  /* return ((float3)(1.0, 0.9, 0.8))*1.0f/max(steps*0.1f, 1.0f); // this version is significantly faster */
+  return scene->matColor.xyz * scene->lightColor.xyz * fmax(0.3f, dot(lPosNorm, *normal)) * 1.0f/(llen * llen * 0.03f);
 }
 
-inline float3 trace(const Ray ray, uint4* randState) {
+// 'hitDist' is set to the distance of the hit point or to -1 if the ray misses the scene
+inline float3 trace(const Ray ray, const float2 start, constant SceneParams* scene,
+                    const DistanceField field, Sampler* sampler, float* hitDist) {
   float t;
   int steps;
-  if((steps = march(ray, &t)) != -1) {
-    // fixed ligthning
-    const float3 pos = ray.origin + ray.dir * (t);
-    float3 normal = calcNormal(pos);
-    float3 lPos = light - pos;
-    float llen = length(lPos);
-    float3 lPosNorm = normalize(lPos);
-    Ray shadowRay = {pos, lPosNorm};
-    // lightning from the camera
-    float3 lcPos = ray.origin - pos;
-    float lclen = length(lcPos);
-    float3 lcPosNorm = normalize(lcPos);
-    Ray shadowRayCam = {pos, lcPosNorm};
-    
-    /* return ((float3)(1.0, 0.9, 0.8))*1.0f/max(steps*0.1f, 1.0f); // this version is significantly faster */
-    return fmax(0.07f, softshadow(shadowRay, 2.0f * RAYMARCH_PRECISION, MAX_SCENE_BOUNDS, 4.0f)) * 
-                      matColor * lightColor * fmax(0.3f, dot(lPosNorm, normal)) * 1.0f/(llen * llen * 0.03f) *
-                      pow(calcAO(pos, normal, randState), 1.0f/2.2f);
+  *hitDist = -1.0f;
+  if((steps = march(ray, start, scene, field, &t)) != -1) {
+    *hitDist = t;
+    float3 normal;
+    Ray shadowRay;
+    float3 color = shadeHit(ray, t, steps, scene, &normal, &shadowRay);
+#if SCENE_SHADOWS
+    color *= fmax(scene->shadowMinLight, softshadow(shadowRay, 2.0f * hitEpsilon(shadowRay, 0.0f, scene), MAX_SCENE_BOUNDS, scene->shadowSoftness, scene));
+#endif
+#if SCENE_AO
+    color *= aoFactor(shadowRay.origin, normal, shadowRay.cone.x, scene, sampler);
+#endif
+    return color;
   }
-  return backgroundColor;
-}
-
-kernel void raymarch(read_write image2d_t image,
-                     global float4* imageRaw,
-                     global uint4* randStates,
-                     constant float3x4* vMatrix,
-                     const int width,
-                     const int height,
-                     int sampleCount,
-                     float fov) {
-  const int x = get_global_id(0);
-  const int y = get_global_id(1);
-
-  if (x >= width || y >= height)
-    return;
-
-  const uint imgIndex = y*width + x;
-  uint4 r = randStates[imgIndex];
-  const int2 coords = (int2)(x, y);
-  const float r1 = 2.0f*rand(&r);
-  const float dx = r1<1.0f ? sqrt(r1)-1.0f: 1.0f-sqrt(2.0f-r1);
-  const float r2 = 2.0f*rand(&r);
-  const float dy = r2<1.0f ? sqrt(r2)-1.0f: 1.0f-sqrt(2.0f-r2);
-  const float invWidth = 1.0f / (float)width;
-  const float u = ((float)x + 0.5f + dx) * invWidth * 2.0f - 1.0f;
-  const float v = ((float)y + 0.5f + dy) * invWidth * 2.0f - (float)height/(float)width;
-  const float3 dir = matMul3x4NoTrans(vMatrix, normalize((float3)(u,v, fmin(-fov, -0.0001f))));
-  const Ray ray = {matMul3x4(vMatrix, (float4)(0.0f, 0.0f, 0.0f, 1.0f)).xyz, dir};
-  float4 val;
-  val = (sampleCount - 1 ? imageRaw[imgIndex] : (float4)(0.0f)) + (float4)(trace(ray, &r), 1.0f);
-  imageRaw[imgIndex] = val;
-  randStates[imgIndex] = r;
-
-  write_imagef(image, coords, val/(float)sampleCount);
+  return scene->backgroundColor.xyz;
 }
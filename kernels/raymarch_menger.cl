@@ -1,21 +1,39 @@
 //------------------------------------------------------------------------------
 // Constants
+// the scene registry (see include/SceneRegistry.hpp) bakes the constants with #ifndef into the
+// program with -D options, the defaults are used if the program is built without them
 //------------------------------------------------------------------------------
 #define MAX_SCENE_BOUNDS 1000.0f
+#ifndef MAX_RAYMARCH_STEPS
 #define MAX_RAYMARCH_STEPS 1500
+#endif
+#ifndef RAYMARCH_PRECISION
 #define RAYMARCH_PRECISION 0.000001f
+#endif
+#define FILTER_WIDTH 0.5f // the radius of the tent filter in pixels
+// the sponge is only shaded by the count of march steps, see 'cameraMarchRange'
+#define SCENE_STEP_SHADED 1
+#ifndef SCENE_SHADOWS
+#define SCENE_SHADOWS 0
+#endif
+#ifndef SCENE_AO
+#define SCENE_AO 0
+#endif
 
 inline float DEBox(float3 pos, float hlen) {
   return max(fabs(pos.x), max(fabs(pos.y), fabs(pos.z))) - hlen;
 }
 
-inline float DEMengerSponge(float3 pos) {
-  const float scale = 3.0f; //menger constants
-  const float scaleM = 3.0f - 1.0f; //menger constants
-  const float3 offset = (float3)(1.0f, 1.0f, 1.0f);
-  const int iters = 10;
-  const float psni = pow(scale, -(float)iters);
-  for (int n = 0; n < iters; n++) {
+// the scale, the offset and the iterations are in 'scene', see SceneParams::toCL, the sponge is
+// inside of the box of every iteration, so the distance to the box is a lower bound, which is
+// close enough as soon as the point is further away from the box than the size of the box
+inline float DEMengerSponge(float3 pos, const int iterations, constant SceneParams* scene) {
+  const float scale = scene->mengerScale; //menger constants
+  const float scaleM = scale - 1.0f; //menger constants
+  const float3 offset = scene->mengerOffset.xyz;
+  const float hlen = scale * 0.3333334f;
+  float distanceScale = 1.0f;
+  for (int n = 0; n < iterations && DEBox(pos, hlen) < hlen; n++) {
     pos = fabs(pos);
     if (pos.x < pos.y)
       pos.xy = pos.yx;
@@ -27,84 +45,101 @@ inline float DEMengerSponge(float3 pos) {
     pos = pos * scale - offset * (scaleM);
     if (pos.z < -0.5f * offset.z * (scaleM))
       pos.z += offset.z * (scaleM);
+    distanceScale *= scene->mengerInvScale;
   }
-  return DEBox(pos, scale * 0.3333334f) * psni;
+  return DEBox(pos, hlen) * distanceScale;
 }
 
-inline float DE(const float3 pos) {
-  return DEMengerSponge(pos);
+inline float DE(const float3 pos, const int iterations, constant SceneParams* scene) {
+  return DEMengerSponge(pos, iterations, scene);
 }
 
-float3 calcNormal( const float3 pos ) {
-  const float3 epsX = (float3)(RAYMARCH_PRECISION , 0.0f, 0.0f);
-  const float3 epsY = (float3)(0.0f, RAYMARCH_PRECISION, 0.0f);
-  const float3 epsZ = (float3)(0.0f, 0.0f, RAYMARCH_PRECISION);
-  int tmpMatID;
-  float3 n = (float3)(
-      DE(pos+epsX) - DE(pos-epsX),
-      DE(pos+epsY) - DE(pos-epsY),
-      DE(pos+epsZ) - DE(pos-epsZ));
-  return normalize(n);
-}
+// 'DEMengerSponge' with dual numbers, the gradient is the normal of the surface
+inline dual DEMengerSpongeDual(dual3 pos, const int iterations, constant SceneParams* scene) {
+  const float scale = scene->mengerScale; //menger constants
+  const float scaleM = scale - 1.0f; //menger constants
+  const float3 offset = scene->mengerOffset.xyz;
+  const float hlen = scale * 0.3333334f;
+  float distanceScale = 1.0f;
+  for (int n = 0; n < iterations && DEBox(pos.val, hlen) < hlen; n++) {
+    pos = dual3Fabs(pos);
+    if (pos.val.x < pos.val.y)
+      dual3Swizzle(pos, xy, yx);
+    if (pos.val.x < pos.val.z)
+      dual3Swizzle(pos, xz, zx);
+    if (pos.val.y < pos.val.z)
+      dual3Swizzle(pos, yz, zy);
 
-int march(const Ray ray, float* t) {
-  const float tmin = RAYMARCH_PRECISION*3.0f;
-  float _t = tmin;
-  int steps = -1;
-  for(int i = 0; i < MAX_RAYMARCH_STEPS; ++i) {
-    float dis = DE(ray.origin+ray.dir*_t);
-    if( dis < RAYMARCH_PRECISION || _t > MAX_SCENE_BOUNDS)
-      break;
-    _t += dis;
-    steps = i;
+    pos = dual3Add(dual3Scale(pos, scale), -offset * (scaleM));
+    if (pos.val.z < -0.5f * offset.z * (scaleM))
+      pos.val.z += offset.z * (scaleM);
+    distanceScale *= scene->mengerInvScale;
   }
-  *t = _t;
-  if( _t > MAX_SCENE_BOUNDS)
-    return -1;
-  return steps;
+  // the box distance is the largest absolute component, see 'DEBox'
+  pos = dual3Fabs(pos);
+  const int c = pos.val.x >= pos.val.y && pos.val.x >= pos.val.z ? 0
+              : pos.val.y >= pos.val.z                            ? 1
+                                                                  : 2;
+  dual d = dual3Component(pos, c);
+  d.val = (d.val - hlen) * distanceScale;
+  d.grad *= distanceScale;
+  return d;
 }
 
-inline float3 trace(const Ray ray) {
-  float t;
-  int steps;
-  if((steps = march(ray, &t)) != -1)
-    return ((float3)(1.0, 0.9, 0.8))*1.0f/max(steps*0.1f, 1.0f);
-  return (float3)(0.0f, 0.0f, 0.0f);
+inline dual DEDual(const dual3 pos, const int iterations, constant SceneParams* scene) {
+  return DEMengerSpongeDual(pos, iterations, scene);
+}
+
+// every iteration shrinks the detail by 'mengerScale'
+inline int DEIterations(const float footprint, constant SceneParams* scene) {
+  return lodIterations(footprint, scene->mengerLodFactor, scene->mengerIterations);
+}
+
+// the sponge is inside of the box of the first iteration, see 'DEMengerSponge', the margin keeps
+// the hits on the faces of the box inside
+inline float3 sceneExtent(constant SceneParams* scene) {
+  return (float3)(scene->mengerScale * 0.3333334f + 2.0f * RAYMARCH_PRECISION);
 }
 
-kernel void raymarch(read_write image2d_t image,
-    global float4* imageRaw,
-    global uint4* randStates,
-    constant float3x4* vMatrix,
-    const int width,
-    const int height,
-    int sampleCount,
-    float fov) {
-  const int x = get_global_id(0);
-  const int y = get_global_id(1);
+inline float2 sceneBounds(const Ray ray, constant SceneParams* scene) {
+  const float3 hlen = sceneExtent(scene);
+  return intersectBox(ray, -hlen, hlen);
+}
+
+// the iterations of the lower bounds of the baked distance field and the cone prepass at the size
+// 'radius' (a cell or the cross section of a cone), every iteration only removes volume from the
+// sponge, so the coarser budget of the size is a lower bound for the sponges of all finer budgets
+inline int boundIterations(const float radius, constant SceneParams* scene) {
+  return DEIterations(radius, scene);
+}
 
-  if (x >= width || y >= height)
-    return;
+// the sponge is shaded without normals, the estimator only matters for other shading
+#ifndef NORMAL_ESTIMATOR
+#define NORMAL_ESTIMATOR NORMAL_TETRAHEDRAL
+#endif
+#include "normal.cl"
 
-  const uint imgIndex = y*width + x;
-  uint4 r = randStates[imgIndex];
-  const int2 coords = (int2)(x, y);
-  const float r1 = 2.0f*rand(&r);
-  const float dx = r1<1.0f ? sqrt(r1)-1.0f: 1.0f-sqrt(2.0f-r1);
-  const float r2 = 2.0f*rand(&r);
-  const float dy = r2<1.0f ? sqrt(r2)-1.0f: 1.0f-sqrt(2.0f-r2);
+// the march and the soft shadows with the tolerances of the pixel footprint
+#include "march.cl"
 
-  const float invWidth = 1.0f / (float)width;
-  const float u = ((float)x + 0.5f + dx/2.0f) * invWidth * 2.0f - 1.0f;
-  const float v = ((float)y + 0.5f + dy/2.0f) * invWidth * 2.0f - (float)height/(float)width;
-  //  const float u = ((float)x) * invWidth * 2.0f - 1.0f;
-  //  const float v = ((float)y) * invWidth * 2.0f - (float)height/(float)width;
-  const float3 dir = matMul3x4NoTrans(vMatrix, normalize((float3)(u,v, fmin(-fov, -0.0001f))));
-  const Ray ray = {matMul3x4(vMatrix, (float4)(0.0f, 0.0f, 0.0f, 1.0f)).xyz, dir};
-  float4 val;
-  val = (sampleCount - 1 ? imageRaw[imgIndex] : (float4)(0.0f, 0.0f, 0.0f, 0.0f)) + (float4)(trace(ray), 1.0f);
-  imageRaw[imgIndex] = val;
-  randStates[imgIndex] = r;
+// the color of the hit point of 'ray' at the distance 't', the sponge is only shaded by the count
+// of march steps, so there are no shadow rays and no ambient occlusion
+inline float3 shadeHit(const Ray ray, const float t, const int steps,
+                       constant SceneParams* scene, float3* normal, Ray* shadowRay) {
+  return ((float3)(1.0, 0.9, 0.8))*1.0f/max(steps*0.1f, 1.0f);
+}
 
-  write_imagef(image, coords, val/(float)sampleCount);
+// 'hitDist' is set to the distance of the hit point or to -1 if the ray misses the scene
+inline float3 trace(const Ray ray, const float2 start, constant SceneParams* scene,
+                    const DistanceField field, Sampler* sampler, float* hitDist) {
+  float t;
+  int steps;
+  float3 normal;
+  Ray shadowRay;
+  *hitDist = -1.0f;
+  if((steps = march(ray, start, scene, field, &t)) != -1) {
+    *hitDist = t;
+    return shadeHit(ray, t, steps, scene, &normal, &shadowRay);
+  }
+  return scene->backgroundColor.xyz;
 }
@@ -0,0 +1,614 @@
+//------------------------------------------------------------------------------
+// Render kernels
+// every scene has to define FILTER_WIDTH, MAX_SCENE_BOUNDS, 'DE', 'DEIterations',
+// 'boundIterations', 'float3 trace(const Ray ray, const float2 start, constant SceneParams* scene,
+// const DistanceField field, Sampler* sampler, float* hitDist)' and for the wavefront kernels
+// 'shadeHit' and the functions of march.cl, SCENE_SHADOWS and SCENE_AO are 0 or 1, scenes with
+// SCENE_AO have to define 'aoFactor', all of them read the parameters of the scene from 'scene'
+//------------------------------------------------------------------------------
+
+#define CONE_TILE_SIZE 8 // the size of the tiles of the finest level of the cone prepass
+
+// the distance and the count of steps the camera rays of the pixel start marching from
+inline float2 marchStart(const int x, const int y, const int width,
+                         global const float2* coneStart, const int useConeStart) {
+  if (!useConeStart)
+    return (float2)(0.0f);
+  const int tilesX = (width + CONE_TILE_SIZE - 1) / CONE_TILE_SIZE;
+  return coneStart[(y / CONE_TILE_SIZE) * tilesX + x / CONE_TILE_SIZE];
+}
+
+// renders 'samplesPerLaunch' samples for the pixel and accumulates them in the raw image, the w
+// component of the raw image contains the count of samples of the pixel, 'imageMoment' contains
+// the sum of the squared luminance of all samples and 'hitPositions' the hit point of the last
+// sample, w is 0 if it missed the scene, the samples have the indices beginning with 'sampleIndex'
+// and the indices within the accumulation beginning with 'sequenceIndex' for the sampler, 'field'
+// is the baked distance field of the march
+inline float4 renderPixel(const int x, const int y, const int width, const int height,
+                          const float fov, constant float3x4* vMatrix,
+                          constant SceneParams* scene, const int samplesPerLaunch,
+                          const bool reset, global float4* imageRaw, global float* imageMoment,
+                          global float4* hitPositions, const uint randSeed,
+                          const uint sampleIndex, const uint sequenceIndex,
+                          global const float* blueNoise, const float2 start,
+                          const DistanceField field) {
+  const uint imgIndex = y*width + x;
+  float4 val = reset ? (float4)(0.0f) : imageRaw[imgIndex];
+  float moment = reset ? 0.0f : imageMoment[imgIndex];
+  float4 hitPosition;
+  for (int i = 0; i < samplesPerLaunch; ++i) {
+    Sampler sampler = samplerInit(randSeed + imgIndex, (int2)(x, y), sampleIndex + i,
+                                  sequenceIndex + i, blueNoise);
+    const Ray ray = generateCameraRay(x, y, width, height, fov, vMatrix, FILTER_WIDTH, &sampler);
+    float hitDist;
+    const float3 color = trace(ray, start, scene, field, &sampler, &hitDist);
+    const float lum = luminance(color);
+    val += (float4)(color, 1.0f);
+    moment += lum*lum;
+    hitPosition = (float4)(ray.origin + ray.dir*hitDist, hitDist >= 0.0f ? 1.0f : 0.0f);
+  }
+  imageRaw[imgIndex] = val;
+  imageMoment[imgIndex] = moment;
+  hitPositions[imgIndex] = hitPosition;
+  return val;
+}
+
+// renders 'samplesPerLaunch' samples per pixel, 'sampleCount' is the count of samples per pixel
+// after this launch, the raw image is reset if it is equal to 'samplesPerLaunch', 'randSeed' is
+// added to the pixel indices and 'sampleIndex' is the index of the first sample of this launch for
+// the sampler, 'blueNoise' is the blue noise tile of SAMPLER_BLUE_NOISE, the march takes the
+// steps of the baked 'distanceField' far from the surface, a resolution of 0 disables it
+kernel void raymarch(read_write image2d_t image,
+                     global float4* imageRaw,
+                     global float* imageMoment,
+                     global float4* hitPositions,
+                     const uint randSeed,
+                     const uint sampleIndex,
+                     global const float* blueNoise,
+                     constant float3x4* vMatrix,
+                     constant SceneParams* scene,
+                     const int width,
+                     const int height,
+                     const int sampleCount,
+                     const int samplesPerLaunch,
+                     const float fov,
+                     global const float2* coneStart,
+                     const int useConeStart,
+                     global const float* distanceField,
+                     const int distanceFieldResolution) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if (x >= width || y >= height)
+    return;
+
+  const DistanceField field = {distanceField, distanceFieldResolution};
+  const float4 val =
+      renderPixel(x, y, width, height, fov, vMatrix, scene, samplesPerLaunch,
+                  sampleCount <= samplesPerLaunch, imageRaw, imageMoment, hitPositions, randSeed,
+                  sampleIndex, sampleCount - samplesPerLaunch, blueNoise,
+                  marchStart(x, y, width, coneStart, useConeStart), field);
+  write_imagef(image, (int2)(x, y), val/val.w);
+}
+
+// like 'raymarch', but only renders the pixels in the list 'activePixels'
+kernel void raymarchActive(read_write image2d_t image,
+                           global float4* imageRaw,
+                           global float* imageMoment,
+                           global float4* hitPositions,
+                           const uint randSeed,
+                           const uint sampleIndex,
+                           global const float* blueNoise,
+                           constant float3x4* vMatrix,
+                           constant SceneParams* scene,
+                           const int width,
+                           const int height,
+                           const int sampleCount,
+                           const int samplesPerLaunch,
+                           const float fov,
+                           global const uint* activePixels,
+                           const uint activeCount,
+                           global const float2* coneStart,
+                           const int useConeStart,
+                           global const float* distanceField,
+                           const int distanceFieldResolution) {
+  const uint i = get_global_id(0);
+
+  if (i >= activeCount)
+    return;
+
+  const int x = activePixels[i] % width;
+  const int y = activePixels[i] / width;
+  const DistanceField field = {distanceField, distanceFieldResolution};
+  const float4 val = renderPixel(x, y, width, height, fov, vMatrix, scene, samplesPerLaunch,
+                                 false, imageRaw, imageMoment, hitPositions, randSeed, sampleIndex,
+                                 sampleCount - samplesPerLaunch, blueNoise,
+                                 marchStart(x, y, width, coneStart, useConeStart), field);
+  write_imagef(image, (int2)(x, y), val/val.w);
+}
+
+// true if the standard error of the mean luminance is below 'errorThreshold' relative to the mean
+inline bool isConverged(const float4 raw, const float moment, const float errorThreshold) {
+  const float n = raw.w;
+  if (n < 2.0f)
+    return false;
+  const float mean = luminance(raw.xyz) / n;
+  const float variance = fmax(moment / n - mean*mean, 0.0f) * n / (n - 1.0f);
+  return sqrt(variance / n) <= errorThreshold * (mean + 0.01f);
+}
+
+// appends the index of every pixel, that isn't converged yet, to 'activePixels', the pixels are
+// counted per work-group first, so there is only one global atomic per work-group and the
+// pixels of a work-group stay next to each other in the list
+kernel void compactUnconverged(global const float4* imageRaw,
+                               global const float* imageMoment,
+                               const int width,
+                               const int height,
+                               const float errorThreshold,
+                               global uint* activePixels,
+                               global uint* activeCount) {
+  local uint localCount;
+  local uint localOffset;
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const bool first = get_local_id(0) == 0 && get_local_id(1) == 0;
+
+  if (first)
+    localCount = 0;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  const uint imgIndex = y*width + x;
+  const bool active = x < width && y < height &&
+                      !isConverged(imageRaw[imgIndex], imageMoment[imgIndex], errorThreshold);
+  uint localIndex = 0;
+  if (active)
+    localIndex = atomic_inc(&localCount);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (first)
+    localOffset = atomic_add(activeCount, localCount);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (active)
+    activePixels[localOffset + localIndex] = imgIndex;
+}
+
+//------------------------------------------------------------------------------
+// Temporal reprojection
+// after the camera moved, the accumulated samples of the previous view are reused for all pixels
+// whose hit point was visible in the previous view as well
+//------------------------------------------------------------------------------
+
+#define REPROJECT_TOLERANCE 0.01f // the allowed distance between the hit points per distance
+
+// adds the reprojected samples of the previous view to the samples of the current view, the raw
+// image, the moments and the hit points of the previous view are in 'history*', 'historyInvVMatrix'
+// transforms from world space to the camera space of the previous view, which may have had a
+// different size (e.g. with dynamic resolution), only the rows 'firstRow'
+// to 'lastRow' (exclusive) are rendered by this launch, so only they are used for clamping
+kernel void reproject(read_write image2d_t image,
+                      global const float4* imageRaw,
+                      global float4* reprojectedRaw,
+                      global float* imageMoment,
+                      global const float4* hitPositions,
+                      global const float4* historyRaw,
+                      global const float* historyMoment,
+                      global const float4* historyHitPositions,
+                      constant float3x4* vMatrix,
+                      const float4 historyInvVMatrix0,
+                      const float4 historyInvVMatrix1,
+                      const float4 historyInvVMatrix2,
+                      const int width,
+                      const int height,
+                      const int historyWidth,
+                      const int historyHeight,
+                      const float fov,
+                      const float historyFov,
+                      const int firstRow,
+                      const int lastRow,
+                      const float maxHistorySamples) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if (x >= width || y >= lastRow)
+    return;
+
+  const uint imgIndex = y*width + x;
+  float4 val = imageRaw[imgIndex];
+  float moment = imageMoment[imgIndex];
+  const float4 hit = hitPositions[imgIndex];
+  const float3 origin = matMul3x4(vMatrix, (float4)(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+
+  // the missed rays are reprojected by their direction through the center of the pixel
+  float3 pos = hit.xyz;
+  if (hit.w == 0.0f) {
+    const float invWidth = 1.0f / (float)width;
+    const float u = ((float)x + 0.5f) * invWidth * 2.0f - 1.0f;
+    const float v = ((float)y + 0.5f) * invWidth * 2.0f - (float)height/(float)width;
+    pos = origin + MAX_SCENE_BOUNDS *
+          matMul3x4NoTrans(vMatrix, normalize((float3)(u, v, fmin(-fov, -0.0001f))));
+  }
+
+  // the pixel of the previous view, see 'generateCameraRay'
+  const float4 pos4 = (float4)(pos, 1.0f);
+  const float3 c = (float3)(dot(historyInvVMatrix0, pos4), dot(historyInvVMatrix1, pos4),
+                            dot(historyInvVMatrix2, pos4));
+  const float planeDist = fmax(historyFov, 0.0001f);
+  const float u = c.x * planeDist / -c.z;
+  const float v = c.y * planeDist / -c.z;
+  const int hx = (int)floor((u + 1.0f) * 0.5f * historyWidth);
+  const int hy =
+      (int)floor((v + (float)historyHeight/(float)historyWidth) * 0.5f * historyWidth);
+
+  if (c.z < 0.0f && hx >= 0 && hx < historyWidth && hy >= 0 && hy < historyHeight) {
+    const uint historyIndex = hy*historyWidth + hx;
+    const float4 historyHit = historyHitPositions[historyIndex];
+    // the hit point is disoccluded if the previous view saw a different surface at this pixel
+    const bool valid =
+        hit.w == 0.0f ? historyHit.w == 0.0f
+                      : historyHit.w != 0.0f && distance(historyHit.xyz, hit.xyz) <=
+                                                    REPROJECT_TOLERANCE * distance(hit.xyz, origin);
+    const float4 history = historyRaw[historyIndex];
+    if (valid && history.w > 0.0f) {
+      // the history is clamped to the colors of the neighbourhood in the current view, so it
+      // can't keep colors which aren't visible anymore (e.g. moved shadows)
+      float3 minColor = (float3)(INFINITY);
+      float3 maxColor = (float3)(-INFINITY);
+      for (int ny = max(y - 1, firstRow); ny <= min(y + 1, lastRow - 1); ++ny) {
+        for (int nx = max(x - 1, 0); nx <= min(x + 1, width - 1); ++nx) {
+          const float4 n = imageRaw[ny*width + nx];
+          minColor = fmin(minColor, n.xyz / n.w);
+          maxColor = fmax(maxColor, n.xyz / n.w);
+        }
+      }
+      const float count = fmin(history.w, maxHistorySamples);
+      const float3 mean = clamp(history.xyz / history.w, minColor, maxColor);
+      val += (float4)(mean * count, count);
+      moment += historyMoment[historyIndex] / history.w * count;
+    }
+  }
+
+  reprojectedRaw[imgIndex] = val;
+  imageMoment[imgIndex] = moment;
+  write_imagef(image, (int2)(x, y), val/val.w);
+}
+
+//------------------------------------------------------------------------------
+// Cone prepass
+// marches one cone per tile of pixels, which contains the camera rays of all pixels of the tile,
+// and stores the distance up to which the cone is empty, every level halves the size of the tiles
+// and continues from the distance of its parent tile, the render kernels start from the finest
+// level instead of the camera
+//------------------------------------------------------------------------------
+
+// 'start' and 'parentStart' contain the distance and the count of steps per tile, 'parentStart'
+// belongs to the level with twice the tile size and is ignored if 'hasParent' isn't set
+kernel void conePrepass(global const float2* parentStart,
+                        global float2* start,
+                        constant float3x4* vMatrix,
+                        constant SceneParams* scene,
+                        const int width,
+                        const int height,
+                        const float fov,
+                        const int tileSize,
+                        const int hasParent) {
+  const int tx = get_global_id(0);
+  const int ty = get_global_id(1);
+  const int tilesX = (width + tileSize - 1) / tileSize;
+  const int tilesY = (height + tileSize - 1) / tileSize;
+
+  if (tx >= tilesX || ty >= tilesY)
+    return;
+
+  const int parentTilesX = (width + 2*tileSize - 1) / (2*tileSize);
+  const float2 parent = hasParent ? parentStart[(ty/2)*parentTilesX + tx/2] : (float2)(0.0f);
+
+  // the axis of the cone goes through the center of the tile, see 'generateCameraRay'
+  const float invWidth = 1.0f / (float)width;
+  const float planeDist = fmax(fov, 0.0001f);
+  const float u = ((float)tx + 0.5f) * tileSize * invWidth * 2.0f - 1.0f;
+  const float v = ((float)ty + 0.5f) * tileSize * invWidth * 2.0f - (float)height/(float)width;
+  const float3 dir = matMul3x4NoTrans(vMatrix, normalize((float3)(u, v, -planeDist)));
+  const float3 origin = matMul3x4(vMatrix, (float4)(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+  // the radius of the cone per distance, it covers the corners of the tile and the filter
+  const float radius =
+      (0.70711f * tileSize + FILTER_WIDTH + 1.0f) * 2.0f * invWidth / planeDist;
+
+  float t = fmax(RAYMARCH_PRECISION*3.0f, parent.x);
+  int steps = (int)parent.y;
+  for (; steps < MAX_RAYMARCH_STEPS && t <= MAX_SCENE_BOUNDS; ++steps) {
+    // the footprint of a pixel is at most 'invWidth / planeDist' per distance, the distance has to
+    // be a lower bound for the surfaces of all budgets of the per pixel march, see
+    // 'boundIterations'
+    const float dis = DE(origin + dir*t, boundIterations(t * invWidth / planeDist, scene), scene);
+    // the cone touches the surface
+    if (dis <= radius*t + RAYMARCH_PRECISION)
+      break;
+    // the empty sphere around the axis contains the cross sections of the cone up to this
+    // distance, because the distance of a cross section point to the center is at most its
+    // distance along the axis plus the radius of the cone
+    t = (t + dis) / (1.0f + radius);
+  }
+  start[ty*tilesX + tx] = (float2)(t, (float)steps);
+}
+
+//------------------------------------------------------------------------------
+// Distance field
+// the march takes the steps of a baked field of lower bounds of the distance to the surface as
+// long as it is far from the surface, the field is baked once per scene and its parameters
+//------------------------------------------------------------------------------
+
+// every work-item evaluates 'DE' at the center of one cell of the grid of 'resolution'^3 cells in
+// the box of 'sceneExtent' and stores it minus half of the diagonal of the cell, so it is a lower
+// bound of the distance of every point in the cell, the scene chooses the iterations with
+// 'boundIterations', the bound has to hold for the surfaces of all budgets of the march
+kernel void bakeDistanceField(global float* distances,
+                              const int resolution,
+                              constant SceneParams* scene) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int z = get_global_id(2);
+
+  if (x >= resolution || y >= resolution || z >= resolution)
+    return;
+
+  const float3 extent = sceneExtent(scene);
+  const float3 center = ((float3)(x, y, z) + 0.5f) * (2.0f * extent / (float)resolution) - extent;
+  const float halfDiagonal = length(extent) / (float)resolution;
+  distances[(z*resolution + y)*resolution + x] =
+      DE(center, boundIterations(halfDiagonal, scene), scene) - halfDiagonal;
+}
+
+//------------------------------------------------------------------------------
+// Wavefront kernels
+// every sample is a path, which runs through the stages generate, march, shade, shadow, ao and
+// accumulate, one kernel per stage, the march and shadow kernels use persistent threads, which
+// fetch a new path as soon as their current one is done, so a few long marches don't keep whole
+// work-groups busy
+//------------------------------------------------------------------------------
+
+// the indices of the counters in 'queueCounters', the host has to reset them before every sample
+#define QUEUE_MARCH_NEXT 0 // the next path the march kernel fetches
+#define QUEUE_HIT_COUNT 1  // the count of paths in 'hitQueue'
+#define QUEUE_SHADOW_NEXT 2 // the next entry of 'hitQueue' the shadow kernel fetches
+
+// the state of a path between the stages, the layout has to match PATH_STATE_SIZE of CLRenderer
+typedef struct {
+  float4 origin;   // xyz the origin of the current ray, w the distance to its hit point (the
+                   // distance the march starts from before the march kernel)
+  float4 dir;      // xyz the direction of the current ray, w the count of march steps
+  float4 position; // xyz the hit point of the camera ray, w the growth of the footprint of the
+                   // camera ray per distance (see Ray)
+  float4 normal;   // xyz the normal at the hit point of the camera ray, w is 1 for hits
+  float4 color;    // xyz the radiance of the path, w the footprint at the origin of the shadow ray
+} PathState;
+
+// the index of the pixel of the path, either taken from the list of active pixels or from the
+// consecutive range of pixels that begins with 'pixelOffset'
+inline uint pathPixel(const uint path, const uint pixelOffset, global const uint* activePixels,
+                      const int useActivePixels) {
+  return useActivePixels ? activePixels[path] : pixelOffset + path;
+}
+
+// generates the camera rays of one sample for 'pathCount' pixels, the sample has the indices
+// 'sampleIndex' and 'sequenceIndex' for the sampler like in 'renderPixel'
+kernel void wavefrontGenerate(global PathState* paths,
+                              const uint randSeed,
+                              const uint sampleIndex,
+                              const uint sequenceIndex,
+                              global const float* blueNoise,
+                              constant float3x4* vMatrix,
+                              constant SceneParams* scene,
+                              const int width,
+                              const int height,
+                              const float fov,
+                              const uint pixelOffset,
+                              const uint pathCount,
+                              global const uint* activePixels,
+                              const int useActivePixels,
+                              global const float2* coneStart,
+                              const int useConeStart) {
+  const uint path = get_global_id(0);
+
+  if (path >= pathCount)
+    return;
+
+  const uint pixel = pathPixel(path, pixelOffset, activePixels, useActivePixels);
+  const int x = pixel % width;
+  const int y = pixel / width;
+  Sampler sampler =
+      samplerInit(randSeed + pixel, (int2)(x, y), sampleIndex, sequenceIndex, blueNoise);
+  const Ray ray = generateCameraRay(x, y, width, height, fov, vMatrix, FILTER_WIDTH, &sampler);
+  const float2 start = marchStart(x, y, width, coneStart, useConeStart);
+  paths[path].origin = (float4)(ray.origin, start.x);
+  paths[path].dir = (float4)(ray.dir, start.y);
+  paths[path].position = (float4)(0.0f, 0.0f, 0.0f, ray.cone.y);
+  paths[path].normal = (float4)(0.0f);
+  paths[path].color = (float4)(scene->backgroundColor.xyz, 0.0f);
+}
+
+// marches the camera rays with the same steps as 'march' of the scene, but every thread advances
+// its ray by one step per iteration and fetches the next path as soon as its ray terminates, the
+// paths that hit the scene are appended to 'hitQueue', see 'raymarch' for the distance field
+kernel void wavefrontMarch(global PathState* paths,
+                           global uint* queueCounters,
+                           global uint* hitQueue,
+                           const uint pathCount,
+                           constant SceneParams* scene,
+                           global const float* distanceField,
+                           const int distanceFieldResolution) {
+  const float tmin = RAYMARCH_PRECISION*3.0f;
+  const DistanceField field = {distanceField, distanceFieldResolution};
+  uint path = pathCount; // no path
+  Ray ray;
+  MarchState state;
+  int steps;
+  int i;
+  for (;;) {
+    if (path >= pathCount) {
+      path = atomic_inc(&queueCounters[QUEUE_MARCH_NEXT]);
+      if (path >= pathCount)
+        break;
+      ray.origin = paths[path].origin.xyz;
+      ray.dir = paths[path].dir.xyz;
+      ray.cone = (float2)(0.0f, paths[path].position.w);
+      state = marchInit(cameraMarchRange(ray, fmax(tmin, paths[path].origin.w), scene), scene);
+      i = (int)paths[path].dir.w;
+      steps = i - 1;
+      // the ray misses the bounding volume, so the path is done without a single step
+      if (state.t > state.tmax) {
+        path = pathCount;
+        continue;
+      }
+    }
+
+    bool done = i >= MAX_RAYMARCH_STEPS;
+    if (!done) {
+      done = marchStep(ray, &state, scene, field);
+      if (!done)
+        steps = i++;
+    }
+    if (done) {
+      if (state.t <= state.tmax) {
+        paths[path].origin.w = state.t;
+        paths[path].dir.w = (float)steps;
+        hitQueue[atomic_inc(&queueCounters[QUEUE_HIT_COUNT])] = path;
+      }
+      path = pathCount;
+    }
+  }
+}
+
+// shades the hit points without shadows and ambient occlusion, the shadow ray replaces the camera
+// ray of the path
+kernel void wavefrontShade(global PathState* paths,
+                           global const uint* queueCounters,
+                           global const uint* hitQueue,
+                           constant SceneParams* scene) {
+  const uint hitCount = queueCounters[QUEUE_HIT_COUNT];
+  for (uint i = get_global_id(0); i < hitCount; i += get_global_size(0)) {
+    const uint path = hitQueue[i];
+    const Ray ray = {paths[path].origin.xyz, paths[path].dir.xyz,
+                     (float2)(0.0f, paths[path].position.w)};
+    const float t = paths[path].origin.w;
+    float3 normal;
+    Ray shadowRay;
+    const float3 color = shadeHit(ray, t, (int)paths[path].dir.w, scene, &normal, &shadowRay);
+    paths[path].position.xyz = ray.origin + ray.dir*t;
+    paths[path].normal = (float4)(normal, 1.0f);
+    paths[path].color = (float4)(color, shadowRay.cone.x);
+    paths[path].origin.xyz = shadowRay.origin;
+    paths[path].dir.xyz = shadowRay.dir;
+  }
+}
+
+// marches the shadow rays of the hit points with the same steps as 'softshadow' of the scene and
+// persistent threads like 'wavefrontMarch'
+kernel void wavefrontShadow(global PathState* paths,
+                            global uint* queueCounters,
+                            global const uint* hitQueue,
+                            constant SceneParams* scene) {
+#if SCENE_SHADOWS
+  const uint hitCount = queueCounters[QUEUE_HIT_COUNT];
+  uint path = 0;
+  bool active = false;
+  Ray ray;
+  float t;
+  float maxt;
+  float res;
+  int steps;
+  for (;;) {
+    if (!active) {
+      const uint i = atomic_inc(&queueCounters[QUEUE_SHADOW_NEXT]);
+      if (i >= hitCount)
+        break;
+      path = hitQueue[i];
+      ray.origin = paths[path].origin.xyz;
+      ray.dir = paths[path].dir.xyz;
+      ray.cone = (float2)(paths[path].color.w, 0.0f);
+      const float2 range = marchRange(ray, 2.0f * hitEpsilon(ray, 0.0f, scene), scene);
+      t = range.x;
+      maxt = range.y;
+      res = 1.0f;
+      steps = 0;
+      active = true;
+    }
+
+    bool done = t >= maxt || steps >= MAX_RAYMARCH_STEPS;
+    if (!done) {
+      const float h = DE(ray.origin + ray.dir*t, DEIterations(rayFootprint(ray, t), scene), scene);
+      if (h < hitEpsilon(ray, t, scene)) {
+        res = 0.0f;
+        done = true;
+      } else {
+        res = min(res, scene->shadowSoftness*h/t);
+        t += h;
+        steps++;
+        // the light never falls below 'shadowMinLight'
+        done = res <= scene->shadowMinLight;
+      }
+    }
+    if (done) {
+      paths[path].color.xyz *= fmax(scene->shadowMinLight, res);
+      active = false;
+    }
+  }
+#endif
+}
+
+// darkens the hit points by their ambient occlusion, the dimensions of the sampler continue after
+// the ones of the camera ray, so they are the same as in 'renderPixel'
+kernel void wavefrontAO(global PathState* paths,
+                        global const uint* queueCounters,
+                        global const uint* hitQueue,
+                        const uint randSeed,
+                        const uint sampleIndex,
+                        const uint sequenceIndex,
+                        global const float* blueNoise,
+                        const int width,
+                        const uint pixelOffset,
+                        global const uint* activePixels,
+                        const int useActivePixels,
+                        constant SceneParams* scene) {
+#if SCENE_AO
+  const uint hitCount = queueCounters[QUEUE_HIT_COUNT];
+  for (uint i = get_global_id(0); i < hitCount; i += get_global_size(0)) {
+    const uint path = hitQueue[i];
+    const uint pixel = pathPixel(path, pixelOffset, activePixels, useActivePixels);
+    Sampler sampler = samplerInit(randSeed + pixel, (int2)(pixel % width, pixel / width),
+                                  sampleIndex, sequenceIndex, blueNoise);
+    sampler.dimension = CAMERA_SAMPLE_DIMENSIONS;
+    paths[path].color.xyz *=
+        aoFactor(paths[path].position.xyz, paths[path].normal.xyz, paths[path].color.w, scene,
+                 &sampler);
+  }
+#endif
+}
+
+// accumulates the radiance of the paths in the raw image like 'renderPixel', the raw image is
+// reset if 'reset' is set
+kernel void wavefrontAccumulate(read_write image2d_t image,
+                                global float4* imageRaw,
+                                global float* imageMoment,
+                                global float4* hitPositions,
+                                global const PathState* paths,
+                                const int width,
+                                const uint pixelOffset,
+                                const uint pathCount,
+                                global const uint* activePixels,
+                                const int useActivePixels,
+                                const int reset) {
+  const uint path = get_global_id(0);
+
+  if (path >= pathCount)
+    return;
+
+  const uint pixel = pathPixel(path, pixelOffset, activePixels, useActivePixels);
+  const float3 color = paths[path].color.xyz;
+  const float lum = luminance(color);
+  const float4 val = (reset ? (float4)(0.0f) : imageRaw[pixel]) + (float4)(color, 1.0f);
+  imageRaw[pixel] = val;
+  imageMoment[pixel] = (reset ? 0.0f : imageMoment[pixel]) + lum*lum;
+  hitPositions[pixel] = (float4)(paths[path].position.xyz, paths[path].normal.w);
+  write_imagef(image, (int2)(pixel % width, pixel / width), val/val.w);
+}
@@ -0,0 +1,157 @@
+//------------------------------------------------------------------------------
+// Samplers
+// a sampler provides the random numbers of a sample one dimension after the other, the sampler is
+// chosen with the build option -D SAMPLER_SOBOL, -D SAMPLER_R2 or -D SAMPLER_BLUE_NOISE, the
+// dimensions are independent random numbers without any of them
+// - SAMPLER_SOBOL: the Owen scrambled Sobol sequence, higher dimensions are padded with sets of
+//   four dimensions with shuffled indices (Burley 2020), every pixel is scrambled differently
+// - SAMPLER_R2: the R2 sequence for every pair of dimensions, which is rotated randomly per pixel
+//   and pair
+// - SAMPLER_BLUE_NOISE: the scrambled Sobol sequence of all pixels is the same, but it is rotated
+//   per pixel by a tiled blue noise texture, so the remaining error is distributed as blue noise
+// the sequences are indexed by the index of the sample within the accumulation of the pixel and
+// scrambled differently for every accumulation
+//------------------------------------------------------------------------------
+
+#define BLUE_NOISE_SIZE 64 // the width and height of the blue noise tile, see CLRenderer
+
+// counter based Philox2x32-10 generator, the result is a hash of the counter and the key
+inline uint2 philox2x32(uint2 counter, uint key) {
+  for (int i = 0; i < 10; ++i) {
+    const uint hi = mul_hi(0xD256D193u, counter.x);
+    const uint lo = 0xD256D193u * counter.x;
+    counter = (uint2)(hi ^ key ^ counter.y, lo);
+    key += 0x9E3779B9u;
+  }
+  return counter;
+}
+
+// a cheap hash for the seeds of the scrambling
+inline uint hash(uint x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+
+inline uint hashCombine(const uint seed, const uint v) {
+  return hash(seed ^ (v + 0x9E3779B9u + (seed << 6) + (seed >> 2)));
+}
+
+// the upper 24 bits as a float in [0, 1)
+inline float bitsToFloat(const uint bits) {
+  return (float)(bits >> 8) * 5.96046448e-8f; // 2^-24
+}
+
+inline uint reverseBits(uint x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling in base 2, every bit is flipped depending on the bits above it
+inline uint nestedUniformScramble(uint x, const uint seed) {
+  x = reverseBits(x);
+  // the Laine-Karras permutation only depends on the bits below every bit
+  x ^= x * 0x3D20ADEAu;
+  x += seed;
+  x *= (seed >> 16) | 1u;
+  x ^= x * 0x05526C56u;
+  x ^= x * 0x53A22864u;
+  return reverseBits(x);
+}
+
+// the generator matrices of the first four dimensions of the Sobol sequence (Joe and Kuo)
+constant uint SOBOL_DIRECTIONS[4][32] = {
+    {0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u,
+     0x02000000u, 0x01000000u, 0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u,
+     0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u, 0x00008000u, 0x00004000u,
+     0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+     0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u,
+     0x00000002u, 0x00000001u},
+    {0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u,
+     0xaa000000u, 0xff000000u, 0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u,
+     0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u, 0x80008000u, 0xc000c000u,
+     0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+     0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu,
+     0xaaaaaaaau, 0xffffffffu},
+    {0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u,
+     0x8e000000u, 0xc5000000u, 0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u,
+     0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u, 0xe8808000u, 0x5cc0c000u,
+     0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+     0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu,
+     0x8e00eeeeu, 0xc5005555u},
+    {0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u,
+     0xa2000000u, 0x93000000u, 0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u,
+     0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u, 0x208f8000u, 0x51474000u,
+     0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+     0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u,
+     0x200200a2u, 0x50050093u}};
+
+inline uint sobol(uint index, const uint dimension) {
+  uint x = 0;
+  for (int bit = 0; index != 0; index >>= 1, ++bit)
+    if (index & 1)
+      x ^= SOBOL_DIRECTIONS[dimension][bit];
+  return x;
+}
+
+// the dimension of the Owen scrambled Sobol sequence, every set of four dimensions has its own
+// shuffled order of the indices, so the sets are independent of each other
+inline uint sobolOwen(const uint index, const uint dimension, const uint seed) {
+  const uint setSeed = hashCombine(seed, dimension / 4);
+  const uint x = sobol(nestedUniformScramble(index, setSeed), dimension % 4);
+  return nestedUniformScramble(x, hashCombine(setSeed, dimension % 4));
+}
+
+// the R2 sequence in fixed point, its two dimensions are the fractional parts of multiples of
+// the reciprocals of the plastic number and its square
+inline uint r2Sequence(const uint index, const uint dimension) {
+  return index * (dimension % 2 == 0 ? 3242174889u : 2447445414u);
+}
+
+// the state of the sampler of one sample
+typedef struct {
+  uint key;       // the index of the pixel plus the seed of the renderer
+  uint sample;    // the index of the sample of the pixel, it is unique for every sample
+  uint sequence;  // the index of the sample within the accumulation of the pixel
+  uint scramble;  // the seed of the scrambling of the accumulation
+  int2 pixel;     // the pixel the blue noise tile is looked up with
+  uint dimension; // the index of the next dimension of the sample
+  global const float* blueNoise; // the blue noise tile with values in [0, 1)
+} Sampler;
+
+// 'sample' is unique for every sample of the pixel and 'sequence' is the index of the sample
+// within the accumulation, so their difference is the same for all samples of an accumulation
+inline Sampler samplerInit(const uint key, const int2 pixel, const uint sample,
+                           const uint sequence, global const float* blueNoise) {
+  const Sampler sampler = {key, sample, sequence, hash(sample - sequence), pixel, 0, blueNoise};
+  return sampler;
+}
+
+// the next dimension of the sample, it is in [0, 1)
+inline float sampleNext(Sampler* sampler) {
+  const uint dimension = sampler->dimension++;
+#if defined(SAMPLER_SOBOL)
+  return bitsToFloat(
+      sobolOwen(sampler->sequence, dimension, hashCombine(sampler->scramble, sampler->key)));
+#elif defined(SAMPLER_R2)
+  const uint rotation = hashCombine(hashCombine(sampler->scramble, sampler->key), dimension);
+  return bitsToFloat(r2Sequence(sampler->sequence, dimension) + rotation);
+#elif defined(SAMPLER_BLUE_NOISE)
+  // every dimension uses the tile with another toroidal shift
+  const uint shift = hashCombine(sampler->scramble, dimension);
+  const int x = (sampler->pixel.x + (int)(shift & 0xFFFFu)) % BLUE_NOISE_SIZE;
+  const int y = (sampler->pixel.y + (int)(shift >> 16)) % BLUE_NOISE_SIZE;
+  const float rotation = sampler->blueNoise[y*BLUE_NOISE_SIZE + x];
+  const float value = bitsToFloat(sobolOwen(sampler->sequence, dimension, sampler->scramble)) +
+                      rotation;
+  return value >= 1.0f ? value - 1.0f : value;
+#else
+  return bitsToFloat(philox2x32((uint2)(sampler->sample, dimension), sampler->key).x);
+#endif
+}
@@ -5,7 +5,6 @@ kernel void tonemapSimpleLinear(
     global uchar4 *tonemappedOutput,
     const int width,
     const int height,
-    const float sampleCount,
     const float exposure
     ) {
   const int x = get_global_id(0);
@@ -17,7 +16,8 @@ kernel void tonemapSimpleLinear(
   const uint imgIndex = y*width + x;
 
   // Apply tone-mapping
-  float4 mapped = imageRaw[imgIndex] / sampleCount;
+  // the w component contains the count of samples of this pixel
+  float4 mapped = imageRaw[imgIndex] / fmax(imageRaw[imgIndex].w, 1.0f);
 
   // Apply gamma correction and scale
   float4 normalizedOutput = clamp(pow(mapped, 1.0f / 2.2f), 0.0f, 1.0f) * 255.0f;
@@ -36,7 +36,6 @@ kernel void tonemapSimpleReinhard(
     global uchar4 *tonemappedOutput,
     const int width,
     const int height,
-    const float sampleCount,
     const float exposure
     ){
   const int x = get_global_id(0);
@@ -48,7 +47,8 @@ kernel void tonemapSimpleReinhard(
   const uint imgIndex = y*width + x;
 
   // Apply tone-mapping
-  float4 hdrColor = imageRaw[imgIndex] / sampleCount * exposure;
+  // the w component contains the count of samples of this pixel
+  float4 hdrColor = imageRaw[imgIndex] / fmax(imageRaw[imgIndex].w, 1.0f) * exposure;
   float4 mapped = hdrColor / (hdrColor + 1.0f);
 
   // Apply gamma correction and scale
@@ -1,6 +1,7 @@
 #version 330
 
 uniform sampler2D srcTex;
+uniform vec2 renderSize; // the size of the rendered image in the lower left corner of srcTex
 in vec2 texCoord;
 out vec4 color;
 
@@ -12,8 +13,20 @@ vec3 tonemapExposure(vec3 hdrColor, float exposure) {
 	return vec3(1.0) - exp(-hdrColor * exposure);
 }
 
+// bilinear upsampling of the rendered image, at native resolution every fragment hits the center
+// of its texel, so it's a plain texel fetch
+vec4 upsample(vec2 coord) {
+	vec2 pos = coord * renderSize - 0.5;
+	ivec2 maxTexel = ivec2(renderSize) - 1;
+	ivec2 i0 = clamp(ivec2(floor(pos)), ivec2(0), maxTexel);
+	ivec2 i1 = clamp(ivec2(floor(pos)) + 1, ivec2(0), maxTexel);
+	vec2 f = pos - floor(pos);
+	return mix(mix(texelFetch(srcTex, i0, 0), texelFetch(srcTex, ivec2(i1.x, i0.y), 0), f.x),
+	           mix(texelFetch(srcTex, ivec2(i0.x, i1.y), 0), texelFetch(srcTex, i1, 0), f.x), f.y);
+}
+
 void main() {
-	vec4 fragColor = texture(srcTex, texCoord);
+	vec4 fragColor = upsample(texCoord);
 	// linear tonemapping with gamma correction
 	// color = clamp(vec4(pow(fragColor.xyz, vec3(1.0f / 2.2f)), fragColor.a), 0.0f, 1.0f);
 
@@ -1,9 +1,9 @@
 #include "App.hpp"
 #include "common.hpp"
 
-App::App(SDL_Window *window)
-    : window(window), movementSpeed(2.0f), fov(2.0f), camera(glm::vec3(0.0f, 0.0f, -1.0f)),
-      quit(false) {
+App::App(SDL_Window *window, const SceneVariant &scene)
+    : window(window), movementSpeed(2.0f), fov(2.0f), targetFrameTime(1.0 / 30.0),
+      camera(glm::vec3(0.0f, 0.0f, -1.0f)), quit(false) {
   deltaElapsedTime = 0;
   curTime = Clock::now();
 
@@ -16,9 +16,10 @@ App::App(SDL_Window *window)
 
   int w, h;
   SDL_GetWindowSize(window, &w, &h);
-  oglRenderer.reset(new OGLRenderer(w, h));
+  oglRenderer.reset(new OGLRenderer(w, h, scene));
   oglRenderer->setVMatrix(camera.getViewMatrix());
   oglRenderer->setFov(fov);
+  oglRenderer->setTargetFrameTime(targetFrameTime);
 
   /********** initialize the on screen displayables **********/
   statusBar = std::make_shared<StatusBar>(w, h, "assets/Roboto-Regular.ttf", 20);
@@ -32,6 +33,7 @@ void App::mainLoop() {
     deltaElapsedTime = (double)getPastTime(curTime) / 1.0e9;
     curTime = Clock::now();
     statusBar->setDeltaTimeStep(deltaElapsedTime);
+    oglRenderer->updateFrameTime(deltaElapsedTime);
     statusBar->setSampleCount(oglRenderer->getSampleCount());
     processEvents();
     processKeys();
@@ -109,9 +111,40 @@ void App::processKeys() {
   if (pressedKeys[SDLK_v] && !oldPressedKeys[SDLK_v])
     oglRenderer->setFov(fov /= 1.1f);
 
+  if (pressedKeys[SDLK_c] && !oldPressedKeys[SDLK_c])
+    oglRenderer->setTargetFrameTime(oglRenderer->getTargetFrameTime() > 0.0 ? 0.0
+                                                                            : targetFrameTime);
+
+  if (pressedKeys[SDLK_n] && !oldPressedKeys[SDLK_n])
+    oglRenderer->toggleAdaptiveSampling();
+
+  if (pressedKeys[SDLK_m] && !oldPressedKeys[SDLK_m])
+    oglRenderer->toggleWavefront();
+
+  if (pressedKeys[SDLK_p] && !oldPressedKeys[SDLK_p])
+    oglRenderer->toggleConePrepass();
+
+  if (pressedKeys[SDLK_o] && !oldPressedKeys[SDLK_o])
+    oglRenderer->toggleDistanceField();
+
+  if (pressedKeys[SDLK_t] && !oldPressedKeys[SDLK_t])
+    oglRenderer->toggleTemporalReprojection();
+
+  if (pressedKeys[SDLK_r] && !oldPressedKeys[SDLK_r])
+    oglRenderer->toggleDynamicResolution();
+
+  if (pressedKeys[SDLK_g] && !oldPressedKeys[SDLK_g])
+    oglRenderer->toggleMultiDevice();
+
+  if (pressedKeys[SDLK_k] && !oldPressedKeys[SDLK_k])
+    oglRenderer->nextScene();
+
   if (pressedKeys[SDLK_i] && !oldPressedKeys[SDLK_i])
     oglRenderer->saveRenderedImage("render_");
 
+  if (pressedKeys[SDLK_h] && !oldPressedKeys[SDLK_h])
+    oglRenderer->saveRenderedImageHDR("render_");
+
   if (pressedKeys[SDLK_x])
     quit = true;
   oldPressedKeys = pressedKeys;
@@ -0,0 +1,111 @@
+#include "BlueNoise.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace bluenoise {
+static const float SIGMA = 1.5f; // the standard deviation of the energy filter in pixels
+static const int RADIUS = 6;     // the radius of the energy filter, the rest is negligible
+
+/**
+ * the energy of every pixel is the sum of the gaussian filter of all set pixels, the tightest
+ * cluster is the set pixel with the highest energy and the largest void the unset pixel with the
+ * lowest energy, the tile wraps around at the borders
+ */
+class Pattern {
+  size_t size;
+  std::vector<bool> set;
+  std::vector<float> energy;
+  std::vector<float> filter; // the weights of the offsets in [-RADIUS, RADIUS]^2
+
+public:
+  Pattern(size_t size) : size(size), set(size * size, false), energy(size * size, 0.0f) {
+    for (int y = -RADIUS; y <= RADIUS; ++y)
+      for (int x = -RADIUS; x <= RADIUS; ++x)
+        filter.push_back(std::exp(-(x * x + y * y) / (2.0f * SIGMA * SIGMA)));
+  }
+
+  bool isSet(size_t i) const { return set[i]; }
+
+  void toggle(size_t i) {
+    set[i] = !set[i];
+    const float sign = set[i] ? 1.0f : -1.0f;
+    const int px = i % size;
+    const int py = i / size;
+    const int n = size;
+    for (int y = -RADIUS; y <= RADIUS; ++y)
+      for (int x = -RADIUS; x <= RADIUS; ++x) {
+        const size_t j = ((py + y + n) % n) * size + (px + x + n) % n;
+        energy[j] += sign * filter[(y + RADIUS) * (2 * RADIUS + 1) + x + RADIUS];
+      }
+  }
+
+  size_t tightestCluster() const {
+    size_t best = 0;
+    float bestEnergy = -INFINITY;
+    for (size_t i = 0; i < set.size(); ++i)
+      if (set[i] && energy[i] > bestEnergy) {
+        best = i;
+        bestEnergy = energy[i];
+      }
+    return best;
+  }
+
+  size_t largestVoid() const {
+    size_t best = 0;
+    float bestEnergy = INFINITY;
+    for (size_t i = 0; i < set.size(); ++i)
+      if (!set[i] && energy[i] < bestEnergy) {
+        best = i;
+        bestEnergy = energy[i];
+      }
+    return best;
+  }
+};
+
+std::vector<float> generate(size_t size, uint32_t seed) {
+  const size_t pixelCount = size * size;
+  const size_t initialCount = std::max<size_t>(1, pixelCount / 10);
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> pixel(0, pixelCount - 1);
+
+  // the initial pattern is random and its clusters are moved into the voids until it is even
+  Pattern initial(size);
+  for (size_t count = 0; count < initialCount;) {
+    const size_t i = pixel(random);
+    if (!initial.isSet(i)) {
+      initial.toggle(i);
+      ++count;
+    }
+  }
+  for (;;) {
+    const size_t cluster = initial.tightestCluster();
+    initial.toggle(cluster);
+    const size_t largestVoid = initial.largestVoid();
+    initial.toggle(largestVoid);
+    if (largestVoid == cluster)
+      break;
+  }
+
+  std::vector<size_t> ranks(pixelCount);
+  // the pixels of the initial pattern get the lower ranks, beginning with the tightest cluster
+  Pattern pattern = initial;
+  for (size_t rank = initialCount; rank-- > 0;) {
+    const size_t cluster = pattern.tightestCluster();
+    pattern.toggle(cluster);
+    ranks[cluster] = rank;
+  }
+  // the remaining pixels fill the largest voids one after the other
+  pattern = initial;
+  for (size_t rank = initialCount; rank < pixelCount; ++rank) {
+    const size_t largestVoid = pattern.largestVoid();
+    pattern.toggle(largestVoid);
+    ranks[largestVoid] = rank;
+  }
+
+  std::vector<float> retVal(pixelCount);
+  for (size_t i = 0; i < pixelCount; ++i)
+    retVal[i] = (ranks[i] + 0.5f) / pixelCount;
+  return retVal;
+}
+} // namespace bluenoise
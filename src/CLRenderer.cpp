@@ -0,0 +1,847 @@
+#include "CLRenderer.hpp"
+#include "BlueNoise.hpp"
+#include "CLUtils.hpp"
+#include "MappedFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+/**
+ * inverts an affine transformation, whose last row is (0, 0, 0, 1)
+ */
+static cl_float3x4 invertAffine(const cl_float3x4 &m) {
+  glm::mat4 g(1.0f);
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 3; ++r)
+      g[c][r] = m.m[r].s[c];
+  const glm::mat4 inv = glm::inverse(g);
+  cl_float3x4 retVal;
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 3; ++r)
+      retVal.m[r].s[c] = inv[c][r];
+  return retVal;
+}
+
+CLRenderer::WavefrontKernels::WavefrontKernels(const cl::Program &program)
+    : generate(cl::Kernel(program, "wavefrontGenerate")),
+      march(cl::Kernel(program, "wavefrontMarch")), shade(cl::Kernel(program, "wavefrontShade")),
+      shadow(cl::Kernel(program, "wavefrontShadow")), ao(cl::Kernel(program, "wavefrontAO")),
+      accumulate(cl::Kernel(program, "wavefrontAccumulate")) {}
+
+CLRenderer::CLRenderer(size_t width, size_t height)
+    : width(width), height(height), maxWidth(width), maxHeight(height), sizeChanged(false),
+      sampleCount(0), samplesPerLaunch(1), requestedSamplesPerLaunch(1), rowsPerLaunch(0),
+      rowOffset(0), firstRow(0), rowCount(std::numeric_limits<size_t>::max()), fov(1.0f),
+      sceneParamsChanged(true), randSeed(0), sampleIndex(0), nextSampleIndex(0), activeCount(0),
+      zeros(QUEUE_COUNTER_COUNT, 0), adaptiveSampling(false), adaptivePass(false),
+      errorThreshold(0.01f), minAdaptiveSamples(16), wavefront(false), persistentThreads(0),
+      conePrepass(false), coneStartValid(false), coneStartBuffers(CONE_LEVELS),
+      temporalReprojection(false), historyValid(false), reprojectPass(false),
+      maxHistorySamples(16.0f), passFov(1.0f), passWidth(width), passHeight(height),
+      historyFov(1.0f), historyWidth(width), historyHeight(height), programHash(0),
+      distanceFieldResolution(0), currentFrame(0), framesInFlight(DEFAULT_FRAMES_IN_FLIGHT) {
+  setVMatrix(glm::mat4());
+}
+
+CLRenderer::CLRenderer(size_t width, size_t height, const std::string &renderKernelName,
+                       const std::string &sourceFilename, const std::string &buildOptions,
+                       size_t deviceIndex)
+    : CLRenderer(width, height) {
+  try {
+    auto devices = getAllDevices();
+    if (devices.size() == 0) {
+      std::cerr << "[CLRenderer] no opencl devices available" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (deviceIndex >= devices.size()) {
+      std::cerr << "[CLRenderer] requested device " << deviceIndex << " not available, only "
+                << devices.size() << " devices found" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    device = devices[deviceIndex];
+    context = cl::Context(device);
+    // the profiling events are used for tuning the work-group sizes
+    queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+    // open and compile the program
+    openProgram(sourceFilename, renderKernelName, buildOptions);
+    // setup the buffers with the correct width and height
+    reshape(width, height);
+  } catch (cl::Error error) {
+    std::cerr << "[CLRenderer] error: " << error.what() << "(" << cl::errorString(error.err())
+              << ")" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+std::vector<cl::Device> CLRenderer::getAllDevices() {
+  std::vector<cl::Device> allDevices;
+  std::vector<cl::Platform> platforms;
+  cl::Platform::get(&platforms);
+  for (const auto &p : platforms) {
+    std::vector<cl::Device> devices;
+    try {
+      p.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    } catch (cl::Error error) {
+      continue; // platform without any devices
+    }
+    allDevices.insert(allDevices.end(), devices.begin(), devices.end());
+  }
+  return allDevices;
+}
+
+bool CLRenderer::openProgram(const std::string &filename, const std::string &renderKernelName,
+                             const std::string &buildOptions) {
+  // waits for the background builds of the variants of the previous file
+  programVariants.clear();
+  sourceFilename = filename;
+  this->renderKernelName = renderKernelName;
+  this->buildOptions = buildOptions;
+  requestedBuildOptions = buildOptions;
+
+  std::promise<BuiltProgram> built;
+  built.set_value(buildProgram(buildOptions));
+  programVariants[buildOptions] = built.get_future().share();
+  useProgram(programVariants[buildOptions].get());
+  return true;
+}
+
+CLRenderer::BuiltProgram CLRenderer::buildProgram(const std::string &buildOptions) const {
+  BuiltProgram built;
+  try {
+    // resolve all includes, so the cache key changes as soon as any included file changes
+    std::string sourcecode = ProgramCache::readSource(sourceFilename, {"kernels/"});
+
+    // possibly some definitions for the kernel
+    std::stringstream kerneloptions;
+    kerneloptions << "-I kernels/ " << buildOptions;
+
+    // use the cached binary if available, otherwise build the program from source
+    if (!programCache.load(context, device, sourcecode, kerneloptions.str(), built.program)) {
+      cl::Program::Sources source(1,
+                                  std::make_pair(sourcecode.c_str(), sourcecode.length() + 1));
+
+      // make program of the source code in the context
+      built.program = cl::Program(context, source);
+
+      // build program
+      std::vector<cl::Device> tmpdevices;
+      tmpdevices.push_back(device);
+      built.program.build(tmpdevices, kerneloptions.str().c_str());
+      programCache.store(built.program, device, sourcecode, kerneloptions.str());
+    }
+
+    // the winners depend on the program, e.g. on the scene, so its options are part of the key
+    built.programHash = ProgramCache::hash(sourcecode + '\0' + kerneloptions.str());
+  } catch (cl::Error error) {
+    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+    if (error.err() == CL_BUILD_PROGRAM_FAILURE)
+      std::cerr << "Build log:" << std::endl
+                << built.program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+
+    exit(EXIT_FAILURE);
+  }
+  return built;
+}
+
+void CLRenderer::useProgram(const BuiltProgram &built) {
+  try {
+    program = built.program;
+    programHash = built.programHash;
+    // the field was baked with the distance estimate of the previous program
+    distanceField.reset();
+    renderKernelFunc.reset(
+        new cl::make_kernel<cl::Image &, cl::Buffer &, cl::Buffer &, cl::Buffer &, cl_uint,
+                            cl_uint, const cl::Buffer &, const cl::Buffer &, const cl::Buffer &,
+                            cl_int, cl_int, cl_int, cl_int, cl_float, const cl::Buffer &, cl_int,
+                            const cl::Buffer &, cl_int>(
+            cl::Kernel(program, renderKernelName.c_str())));
+    renderActiveKernelFunc.reset(
+        new cl::make_kernel<cl::Image &, cl::Buffer &, cl::Buffer &, cl::Buffer &, cl_uint,
+                            cl_uint, const cl::Buffer &, const cl::Buffer &, const cl::Buffer &,
+                            cl_int, cl_int, cl_int, cl_int, cl_float, const cl::Buffer &,
+                            cl_uint, const cl::Buffer &, cl_int, const cl::Buffer &, cl_int>(
+            cl::Kernel(program, (renderKernelName + "Active").c_str())));
+    reprojectKernelFunc.reset(new cl::make_kernel<
+                              cl::Image &, const cl::Buffer &, cl::Buffer &, cl::Buffer &,
+                              const cl::Buffer &, const cl::Buffer &, const cl::Buffer &,
+                              const cl::Buffer &, const cl::Buffer &, cl_float4, cl_float4,
+                              cl_float4, cl_int, cl_int, cl_int, cl_int, cl_float, cl_float,
+                              cl_int, cl_int, cl_float>(cl::Kernel(program, "reproject")));
+    conePrepassKernelFunc.reset(
+        new cl::make_kernel<const cl::Buffer &, cl::Buffer &, const cl::Buffer &,
+                            const cl::Buffer &, cl_int, cl_int, cl_float, cl_int, cl_int>(
+            cl::Kernel(program, "conePrepass")));
+    compactKernelFunc.reset(
+        new cl::make_kernel<const cl::Buffer &, const cl::Buffer &, cl_int, cl_int, cl_float,
+                            cl::Buffer &, cl::Buffer &>(
+            cl::Kernel(program, "compactUnconverged")));
+    wavefrontKernels.reset(new WavefrontKernels(program));
+    tonemapKernelFunc.reset(
+        new cl::make_kernel<const cl::Buffer &, cl::Buffer &, cl_int, cl_int, cl_float>(
+            cl::Kernel(program, "tonemapSimpleReinhard")));
+
+    // the launches of the render kernel are split into ranges of rows, see 'setRowsPerLaunch'
+    renderTuner.reset(new WorkGroupTuner(cl::Kernel(program, renderKernelName.c_str()), device,
+                                         built.programHash));
+    tonemapTuner.reset(new WorkGroupTuner(cl::Kernel(program, "tonemapSimpleReinhard"), device,
+                                          built.programHash, 16));
+  } catch (cl::Error error) {
+    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void CLRenderer::prepareProgram(const std::string &buildOptions) {
+  if (programVariants.count(buildOptions) > 0)
+    return;
+  programVariants[buildOptions] =
+      std::async(std::launch::async, [this, buildOptions]() { return buildProgram(buildOptions); })
+          .share();
+}
+
+void CLRenderer::selectProgram(const std::string &buildOptions) {
+  prepareProgram(buildOptions);
+  requestedBuildOptions = buildOptions;
+}
+
+const std::string &CLRenderer::getBuildOptions() const { return buildOptions; }
+
+cl::Image &CLRenderer::getTargetImage() { return imageBuffer; }
+
+void CLRenderer::reshapeTargetImage(size_t width, size_t height) {
+  imageBuffer =
+      cl::Image2D(context, CL_MEM_READ_WRITE, cl::ImageFormat(CL_RGBA, CL_FLOAT), width, height);
+}
+
+void CLRenderer::compactActivePixels() {
+  queue.enqueueWriteBuffer(activeCountBuffer, CL_FALSE, 0, sizeof(cl_uint), zeros.data());
+  cl::EnqueueArgs eargs(
+      queue, cl::NDRange(0, getRangeBegin()),
+      cl::NDRange(cl::nextDivisible(width, 8), cl::nextDivisible(getRangeRows(), 8)),
+      cl::NDRange(8, 8));
+  (*compactKernelFunc)(eargs, imageRawBuffer, imageMomentBuffer, width, height, errorThreshold,
+                       activePixelsBuffer, activeCountBuffer);
+  // opencl 1.x has no indirect dispatch, so the size of the next launch has to be read back
+  queue.enqueueReadBuffer(activeCountBuffer, CL_TRUE, 0, sizeof(cl_uint), &activeCount);
+}
+
+void CLRenderer::renderConePrepass(const FrameResources &frame) {
+  // from the coarsest to the finest level, every level continues from its parent tiles
+  for (size_t level = 0; level < CONE_LEVELS; ++level) {
+    const size_t tileSize = CONE_TILE_SIZE << (CONE_LEVELS - 1 - level);
+    const size_t tilesX = (width + tileSize - 1) / tileSize;
+    const size_t tilesY = (height + tileSize - 1) / tileSize;
+    cl::EnqueueArgs eargs(
+        queue, cl::NDRange(cl::nextDivisible(tilesX, 8), cl::nextDivisible(tilesY, 8)),
+        cl::NDRange(8, 8));
+    (*conePrepassKernelFunc)(eargs, coneStartBuffers[level == 0 ? 0 : level - 1],
+                             coneStartBuffers[level], frame.vMatrixBuffer, sceneParamsBuffer,
+                             width, height, fov, tileSize, level > 0);
+  }
+}
+
+cl::Event CLRenderer::renderReprojection(const FrameResources &frame, size_t firstRow,
+                                        size_t rows) {
+  cl::EnqueueArgs eargs(queue, cl::NDRange(0, firstRow),
+                        cl::NDRange(cl::nextDivisible(width, 8), cl::nextDivisible(rows, 8)),
+                        cl::NDRange(8, 8));
+  // the kernel reads the neighbourhood of every pixel, so it can't write to the raw image itself
+  (*reprojectKernelFunc)(eargs, getTargetImage(), imageRawBuffer, reprojectedRawBuffer,
+                         imageMomentBuffer, hitPositionsBuffer, historyRawBuffer,
+                         historyMomentBuffer, historyHitPositionsBuffer, frame.vMatrixBuffer,
+                         historyInvVMatrix.m[0], historyInvVMatrix.m[1], historyInvVMatrix.m[2],
+                         width, height, historyWidth, historyHeight, fov, historyFov, firstRow,
+                         firstRow + rows, maxHistorySamples);
+  cl::Event done;
+  const size_t offset = firstRow * width * sizeof(cl_float4);
+  queue.enqueueCopyBuffer(reprojectedRawBuffer, imageRawBuffer, offset, offset,
+                          rows * width * sizeof(cl_float4), nullptr, &done);
+  return done;
+}
+
+cl::Event CLRenderer::renderWavefront(const FrameResources &frame, cl_uint pixelOffset,
+                                      cl_uint pixelCount, bool activePixels, bool reset) {
+  cl::EnqueueArgs pathArgs(queue, cl::NDRange(cl::nextDivisible(pixelCount, 64)), cl::NDRange(64));
+  // the persistent kernels fetch their work themselves, so they only need enough threads to fill
+  // the device
+  cl::EnqueueArgs persistentArgs(
+      queue, cl::NDRange(std::min<size_t>(persistentThreads, cl::nextDivisible(pixelCount, 64))),
+      cl::NDRange(64));
+  WavefrontKernels &kernels = *wavefrontKernels;
+  const cl::Buffer &fieldBuffer =
+      distanceField ? distanceField->getBuffer() : noDistanceFieldBuffer;
+  const cl_int fieldResolution = distanceField ? distanceField->getResolution() : 0;
+  cl::Event done;
+  // one sample per pixel after the other, so the paths of a pixel never run at the same time
+  for (cl_int i = 0; i < samplesPerLaunch; ++i) {
+    queue.enqueueWriteBuffer(queueCountersBuffer, CL_FALSE, 0,
+                             QUEUE_COUNTER_COUNT * sizeof(cl_uint), zeros.data());
+    // the index of the sample within the accumulation of the pixels
+    const cl_uint sequenceIndex = sampleCount - samplesPerLaunch + i;
+    kernels.generate(pathArgs, pathStatesBuffer, randSeed, sampleIndex + i, sequenceIndex,
+                     blueNoiseBuffer, frame.vMatrixBuffer, sceneParamsBuffer, width, height,
+                     fov, pixelOffset, pixelCount, activePixelsBuffer, activePixels,
+                     coneStartBuffers.back(), conePrepass);
+    kernels.march(persistentArgs, pathStatesBuffer, queueCountersBuffer, hitQueueBuffer,
+                  pixelCount, sceneParamsBuffer, fieldBuffer, fieldResolution);
+    kernels.shade(persistentArgs, pathStatesBuffer, queueCountersBuffer, hitQueueBuffer,
+                  sceneParamsBuffer);
+    kernels.shadow(persistentArgs, pathStatesBuffer, queueCountersBuffer, hitQueueBuffer,
+                   sceneParamsBuffer);
+    kernels.ao(persistentArgs, pathStatesBuffer, queueCountersBuffer, hitQueueBuffer, randSeed,
+               sampleIndex + i, sequenceIndex, blueNoiseBuffer, width, pixelOffset,
+               activePixelsBuffer, activePixels, sceneParamsBuffer);
+    done = kernels.accumulate(pathArgs, getTargetImage(), imageRawBuffer, imageMomentBuffer,
+                              hitPositionsBuffer, pathStatesBuffer, width, pixelOffset, pixelCount,
+                              activePixelsBuffer, activePixels, reset && i == 0);
+  }
+  return done;
+}
+
+void CLRenderer::render(bool refresh) {
+  // another renderer renders all rows of the image
+  if (getRangeRows() == 0)
+    return;
+  try {
+    // the requested variant replaces the current program as soon as its background build is done
+    if (requestedBuildOptions != buildOptions) {
+      const std::shared_future<BuiltProgram> requested = programVariants[requestedBuildOptions];
+      if (requested.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        // the kernels of the frames in flight still use the current program
+        finish();
+        useProgram(requested.get());
+        buildOptions = requestedBuildOptions;
+        // the samples, the hit points and the cones belong to the previous variant
+        historyValid = false;
+        coneStartValid = false;
+        refresh = true;
+      }
+    }
+    if (frames.size() != framesInFlight) {
+      finish();
+      frames.resize(framesInFlight);
+      for (auto &frame : frames)
+        frame.vMatrixBuffer = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_float3x4));
+      currentFrame = 0;
+    }
+    currentFrame = (currentFrame + 1) % frames.size();
+    FrameResources &frame = frames[currentFrame];
+    // the resources of this frame are reused, so the frame that used them last has to be done
+    if (frame.done())
+      frame.done.wait();
+
+    // a new pass begins, all launches of a pass use the same count of samples per launch
+    refresh = refresh || sizeChanged;
+    sizeChanged = false;
+    const bool passStart = refresh || rowOffset == 0;
+    if (passStart) {
+      // a refresh may interrupt the bands of the previous pass
+      renderTuner->beginPass(rowOffset == 0);
+      rowOffset = 0;
+      samplesPerLaunch = requestedSamplesPerLaunch;
+      // the samples of the previous view become the history, which is reprojected into the new
+      // view after the first samples of the new view are rendered
+      reprojectPass = refresh && temporalReprojection && historyValid;
+      if (reprojectPass) {
+        std::swap(imageRawBuffer, historyRawBuffer);
+        std::swap(imageMomentBuffer, historyMomentBuffer);
+        std::swap(hitPositionsBuffer, historyHitPositionsBuffer);
+        historyInvVMatrix = invertAffine(passVMatrix);
+        historyFov = passFov;
+        historyWidth = passWidth;
+        historyHeight = passHeight;
+      }
+      passVMatrix = vMatrix;
+      passFov = fov;
+      passWidth = width;
+      passHeight = height;
+      // the rows of the new view become a valid history only after the whole pass is rendered
+      if (refresh)
+        historyValid = false;
+      // the converged pixels are only skipped as long as the image is accumulated
+      adaptivePass = adaptiveSampling && !refresh && (size_t)sampleCount >= minAdaptiveSamples;
+      if (adaptivePass) {
+        compactActivePixels();
+        // all pixels are converged, so there is nothing left to render
+        if (activeCount == 0) {
+          queue.flush();
+          return;
+        }
+      }
+      sampleCount = refresh ? samplesPerLaunch : sampleCount + samplesPerLaunch;
+      sampleIndex = nextSampleIndex;
+      nextSampleIndex += samplesPerLaunch;
+    }
+
+    // the parameters rarely change, so the launches using the previous ones are waited for
+    if (sceneParamsChanged) {
+      const cl_scene_params params = sceneParams.toCL();
+      queue.enqueueWriteBuffer(sceneParamsBuffer, CL_TRUE, 0, sizeof(params), &params);
+      sceneParamsChanged = false;
+    }
+    // the field is baked once per program and parameters of the scene
+    if (distanceFieldResolution > 0 && !distanceField)
+      distanceField.reset(new DistanceField(context, queue, program, programHash,
+                                            sceneParamsBuffer, sceneParams.toCL(),
+                                            distanceFieldResolution));
+    const cl::Buffer &fieldBuffer =
+        distanceField ? distanceField->getBuffer() : noDistanceFieldBuffer;
+    const cl_int fieldResolution = distanceField ? distanceField->getResolution() : 0;
+    acquireTargetImage();
+    frame.vMatrix = vMatrix;
+    queue.enqueueWriteBuffer(frame.vMatrixBuffer, CL_FALSE, 0, sizeof(cl_float3x4),
+                             &frame.vMatrix);
+    // the start distances only depend on the view, which changes with a refresh, the following
+    // passes of the accumulation reuse them
+    if (conePrepass && (refresh || !coneStartValid)) {
+      renderConePrepass(frame);
+      coneStartValid = true;
+    }
+    if (adaptivePass) {
+      // the active pixels are rendered with a single launch, because the list is already compact
+      cl::EnqueueArgs eargs(queue, cl::NDRange(cl::nextDivisible(activeCount, 64)),
+                            cl::NDRange(64));
+      if (wavefront)
+        frame.done = renderWavefront(frame, 0, activeCount, true, false);
+      else
+        frame.done = (*renderActiveKernelFunc)(
+            eargs, getTargetImage(), imageRawBuffer, imageMomentBuffer, hitPositionsBuffer,
+            randSeed, sampleIndex, blueNoiseBuffer, frame.vMatrixBuffer, sceneParamsBuffer, width,
+            height, sampleCount, samplesPerLaunch, fov, activePixelsBuffer, activeCount,
+            coneStartBuffers.back(), conePrepass, fieldBuffer, fieldResolution);
+    } else {
+      const size_t rangeRows = getRangeRows();
+      const size_t firstLaunchRow = getRangeBegin() + rowOffset;
+      const size_t rows =
+          rowsPerLaunch == 0 ? rangeRows : std::min(rowsPerLaunch, rangeRows - rowOffset);
+      if (wavefront)
+        frame.done = renderWavefront(frame, firstLaunchRow * width, rows * width, false,
+                                     sampleCount <= samplesPerLaunch);
+      else {
+        cl::EnqueueArgs eargs =
+            renderTuner->launchArgs(queue, cl::NDRange(0, firstLaunchRow), width, rows);
+        frame.done = (*renderKernelFunc)(eargs, getTargetImage(), imageRawBuffer,
+                                         imageMomentBuffer, hitPositionsBuffer, randSeed,
+                                         sampleIndex, blueNoiseBuffer, frame.vMatrixBuffer,
+                                         sceneParamsBuffer, width, height, sampleCount,
+                                         samplesPerLaunch, fov, coneStartBuffers.back(),
+                                         conePrepass, fieldBuffer, fieldResolution);
+        renderTuner->addLaunch(frame.done);
+      }
+      if (reprojectPass)
+        frame.done = renderReprojection(frame, firstLaunchRow, rows);
+      rowOffset = (rowOffset + rows) % rangeRows;
+      // the last band of the pass, so every row contains samples of the current view
+      if (rowOffset == 0)
+        historyValid = true;
+    }
+    releaseTargetImage();
+    queue.flush();
+  } catch (cl::Error error) {
+    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void CLRenderer::finish() {
+  if (queue())
+    queue.finish();
+}
+
+void CLRenderer::setSamplesPerLaunch(size_t samplesPerLaunch) {
+  requestedSamplesPerLaunch = std::max<size_t>(1, samplesPerLaunch);
+}
+
+void CLRenderer::setRowsPerLaunch(size_t rowsPerLaunch) {
+  // multiples of the work-group height, so the launches of a pass don't overlap
+  this->rowsPerLaunch = cl::nextDivisible(rowsPerLaunch, 8);
+}
+
+void CLRenderer::setRowRange(size_t firstRow, size_t rowCount) {
+  if (firstRow == this->firstRow && rowCount == this->rowCount)
+    return;
+  this->firstRow = firstRow;
+  this->rowCount = rowCount;
+  sizeChanged = true;
+  // the history only contains the rows of the previous range
+  historyValid = false;
+}
+
+size_t CLRenderer::getRangeBegin() const { return std::min(firstRow, height); }
+
+size_t CLRenderer::getRangeRows() const { return std::min(rowCount, height - getRangeBegin()); }
+
+void CLRenderer::setFramesInFlight(size_t framesInFlight) {
+  this->framesInFlight = std::max<size_t>(1, framesInFlight);
+}
+
+void CLRenderer::setAdaptiveSampling(bool enabled, float errorThreshold, size_t minSamples) {
+  adaptiveSampling = enabled;
+  this->errorThreshold = errorThreshold;
+  // a pixel needs at least two samples for an estimate of its variance
+  minAdaptiveSamples = std::max<size_t>(2, minSamples);
+}
+
+bool CLRenderer::getAdaptiveSampling() const { return adaptiveSampling; }
+
+void CLRenderer::setWavefront(bool enabled) {
+  if (enabled == wavefront)
+    return;
+  // the buffers may still be in use by frames in flight
+  finish();
+  wavefront = enabled;
+  // enough work-groups per compute unit to hide the latency of the march steps
+  persistentThreads = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * 16 * 64;
+  reshapeWavefrontBuffers();
+}
+
+bool CLRenderer::getWavefront() const { return wavefront; }
+
+void CLRenderer::setConePrepass(bool enabled) {
+  conePrepass = enabled;
+  coneStartValid = false;
+}
+
+bool CLRenderer::getConePrepass() const { return conePrepass; }
+
+void CLRenderer::setRenderSize(size_t width, size_t height) {
+  width = std::max<size_t>(1, std::min(width, maxWidth));
+  height = std::max<size_t>(1, std::min(height, maxHeight));
+  if (width == this->width && height == this->height)
+    return;
+  this->width = width;
+  this->height = height;
+  sizeChanged = true;
+  coneStartValid = false;
+}
+
+void CLRenderer::setTemporalReprojection(bool enabled, float maxHistorySamples) {
+  this->maxHistorySamples = maxHistorySamples;
+  if (enabled == temporalReprojection)
+    return;
+  // the buffers may still be in use by frames in flight
+  finish();
+  temporalReprojection = enabled;
+  reshapeHistoryBuffers();
+}
+
+bool CLRenderer::getTemporalReprojection() const { return temporalReprojection; }
+
+void CLRenderer::setDistanceField(size_t resolution) {
+  if (resolution == distanceFieldResolution)
+    return;
+  distanceFieldResolution = resolution;
+  distanceField.reset();
+}
+
+size_t CLRenderer::getDistanceField() const { return distanceFieldResolution; }
+
+void CLRenderer::reshapeHistoryBuffers() {
+  // the raw image of the current pass is never reprojected from these buffers
+  historyValid = false;
+  if (!temporalReprojection) {
+    historyRawBuffer = cl::Buffer();
+    historyMomentBuffer = cl::Buffer();
+    historyHitPositionsBuffer = cl::Buffer();
+    reprojectedRawBuffer = cl::Buffer();
+    return;
+  }
+  const size_t pixelCount = maxWidth * maxHeight;
+  historyRawBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, pixelCount * sizeof(cl_float4));
+  historyMomentBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, pixelCount * sizeof(cl_float));
+  historyHitPositionsBuffer =
+      cl::Buffer(context, CL_MEM_READ_WRITE, pixelCount * sizeof(cl_float4));
+  reprojectedRawBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, pixelCount * sizeof(cl_float4));
+}
+
+void CLRenderer::reshapeWavefrontBuffers() {
+  if (!wavefront) {
+    pathStatesBuffer = cl::Buffer();
+    hitQueueBuffer = cl::Buffer();
+    queueCountersBuffer = cl::Buffer();
+    return;
+  }
+  pathStatesBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, maxWidth * maxHeight * PATH_STATE_SIZE);
+  hitQueueBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, maxWidth * maxHeight * sizeof(cl_uint));
+  queueCountersBuffer =
+      cl::Buffer(context, CL_MEM_READ_WRITE, QUEUE_COUNTER_COUNT * sizeof(cl_uint));
+}
+
+size_t CLRenderer::getActivePixelCount() const {
+  return adaptivePass ? activeCount : width * getRangeRows();
+}
+
+void CLRenderer::reshape(size_t width, size_t height) {
+  // the buffers may still be in use by frames in flight
+  finish();
+  rowOffset = 0;
+  this->width = width;
+  this->height = height;
+  maxWidth = width;
+  maxHeight = height;
+  sizeChanged = false;
+  passWidth = width;
+  passHeight = height;
+  reshapeTargetImage(width, height);
+  imageRawBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, width * height * sizeof(cl_float4));
+  imageMomentBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, width * height * sizeof(cl_float));
+  hitPositionsBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, width * height * sizeof(cl_float4));
+  activePixelsBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, width * height * sizeof(cl_uint));
+  activeCountBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint));
+  adaptivePass = false;
+  reshapeWavefrontBuffers();
+  reshapeHistoryBuffers();
+  for (size_t level = 0; level < CONE_LEVELS; ++level) {
+    const size_t tileSize = CONE_TILE_SIZE << (CONE_LEVELS - 1 - level);
+    const size_t tileCount =
+        ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+    coneStartBuffers[level] =
+        cl::Buffer(context, CL_MEM_READ_WRITE, tileCount * sizeof(cl_float2));
+  }
+  coneStartValid = false;
+  if (!sceneParamsBuffer())
+    sceneParamsBuffer = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_scene_params));
+  if (!noDistanceFieldBuffer())
+    noDistanceFieldBuffer = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_float));
+  // the blue noise tile doesn't depend on the size, so it is only created once
+  if (!blueNoiseBuffer()) {
+    std::vector<cl_float> blueNoise = bluenoise::generate(BLUE_NOISE_SIZE);
+    blueNoiseBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                 blueNoise.size() * sizeof(cl_float), blueNoise.data());
+  }
+}
+
+void CLRenderer::setRandSeed(cl_uint seed) {
+  randSeed = seed;
+  nextSampleIndex = 0;
+}
+
+void CLRenderer::setVMatrix(cl_float3x4 m) { vMatrix = m; }
+
+void CLRenderer::setVMatrix(glm::mat4 m) {
+  vMatrix = {{{{m[0][0], m[1][0], m[2][0], m[3][0]}},
+              {{m[0][1], m[1][1], m[2][1], m[3][1]}},
+              {{m[0][2], m[1][2], m[2][2], m[3][2]}}}};
+}
+
+void CLRenderer::setFov(cl_float fov) { this->fov = fov; }
+
+void CLRenderer::setSceneParams(const SceneParams &params) {
+  sceneParams = params;
+  sceneParamsChanged = true;
+  // the cone prepass marched through the previous scene and the history was shaded with it
+  coneStartValid = false;
+  historyValid = false;
+  distanceField.reset();
+}
+
+const SceneParams &CLRenderer::getSceneParams() const { return sceneParams; }
+
+size_t CLRenderer::getSampleCount() const {
+  return rowOffset == 0 ? sampleCount : sampleCount - samplesPerLaunch;
+}
+
+size_t CLRenderer::getWidth() const { return width; }
+
+size_t CLRenderer::getHeight() const { return height; }
+
+const cl::Device &CLRenderer::getDevice() const { return device; }
+
+CLRenderer::PinnedImage::PinnedImage(const cl::CommandQueue &queue)
+    : queue(queue), capacity(0), pixels(nullptr), inUse(false), width(0), height(0), hdr(false) {}
+
+CLRenderer::PinnedImage::~PinnedImage() { release(); }
+
+size_t CLRenderer::PinnedImage::getWidth() const { return width; }
+
+size_t CLRenderer::PinnedImage::getHeight() const { return height; }
+
+bool CLRenderer::PinnedImage::isHDR() const { return hdr; }
+
+const void *CLRenderer::PinnedImage::getPixels() {
+  ready.wait();
+  return pixels;
+}
+
+void CLRenderer::PinnedImage::release() {
+  if (pixels != nullptr) {
+    // the queue is thread safe, so the image can be released by a writer thread
+    queue.enqueueUnmapMemObject(buffer, pixels);
+    queue.flush();
+    pixels = nullptr;
+  }
+  inUse = false;
+}
+
+void CLRenderer::readPinnedImage(PinnedImage &image, bool hdr) {
+  const size_t size = width * height * (hdr ? sizeof(cl_float4) : sizeof(cl_uchar4));
+  if (image.capacity < size) {
+    image.buffer = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size);
+    image.capacity = size;
+  }
+  image.inUse = true;
+  image.width = width;
+  image.height = height;
+  image.hdr = hdr;
+  if (hdr)
+    queue.enqueueCopyBuffer(imageRawBuffer, image.buffer, 0, 0, size);
+  else {
+    // every launch tonemaps the whole image
+    tonemapTuner->beginPass();
+    cl::EnqueueArgs eargs = tonemapTuner->launchArgs(queue, cl::NDRange(0, 0), width, height);
+    tonemapTuner->addLaunch(
+        (*tonemapKernelFunc)(eargs, imageRawBuffer, image.buffer, width, height, 1.0f));
+  }
+  image.pixels = queue.enqueueMapBuffer(image.buffer, CL_FALSE, CL_MAP_READ, 0, size, nullptr,
+                                        &image.ready);
+  queue.flush();
+}
+
+std::shared_ptr<CLRenderer::PinnedImage> CLRenderer::getImageAsync(bool hdr) {
+  std::shared_ptr<PinnedImage> image;
+  for (auto &candidate : pinnedImages)
+    if (!candidate->inUse) {
+      image = candidate;
+      break;
+    }
+  if (image == nullptr) {
+    if (pinnedImages.size() >= MAX_PINNED_IMAGES)
+      return nullptr;
+    image.reset(new PinnedImage(queue));
+    pinnedImages.push_back(image);
+  }
+  readPinnedImage(*image, hdr);
+  return image;
+}
+
+std::vector<uint8_t> CLRenderer::getImage() {
+  std::shared_ptr<PinnedImage> image = getImageAsync();
+  // the buffers of all pinned images are still in use by asynchronous readbacks
+  if (image == nullptr) {
+    image.reset(new PinnedImage(queue));
+    readPinnedImage(*image, false);
+  }
+  const uint8_t *pixels = (const uint8_t *)image->getPixels();
+  std::vector<uint8_t> retVal(pixels, pixels + width * height * 4);
+  image->release();
+  return retVal;
+}
+
+std::vector<float> CLRenderer::getRawImage() {
+  std::vector<float> retVal(width * height * 4);
+  queue.enqueueReadBuffer(imageRawBuffer, CL_TRUE, 0, width * height * sizeof(cl_float4),
+                          &(retVal[0]));
+  return retVal;
+}
+
+static const char CHECKPOINT_MAGIC[8] = {'P', 'M', 'C', 'L', 'C', 'K', 'P', '2'};
+
+bool CLRenderer::saveCheckpoint(const std::string &filename) {
+  try {
+    // the frames in flight may still write to the buffers, the rows of an incomplete pass are
+    // stored too, their samples are counted by the w component of the raw image
+    finish();
+    const size_t pixelCount = width * height;
+    const size_t rawOffset = sizeof(CheckpointHeader);
+    const size_t momentOffset = rawOffset + pixelCount * sizeof(cl_float4);
+    const std::string tmpFilename = filename + ".tmp";
+    MappedFile file(tmpFilename, momentOffset + pixelCount * sizeof(cl_float));
+    if (!file.isOpen())
+      return false;
+    CheckpointHeader header;
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.width = width;
+    header.height = height;
+    header.sampleCount = getSampleCount();
+    // an incomplete pass is rendered again after the resume, so its indices are skipped
+    header.sampleIndex = nextSampleIndex;
+    header.fov = passFov;
+    header.vMatrix = passVMatrix;
+    std::memcpy(file.getData(), &header, sizeof(header));
+    queue.enqueueReadBuffer(imageRawBuffer, CL_FALSE, 0, pixelCount * sizeof(cl_float4),
+                            file.getData() + rawOffset);
+    queue.enqueueReadBuffer(imageMomentBuffer, CL_FALSE, 0, pixelCount * sizeof(cl_float),
+                            file.getData() + momentOffset);
+    queue.finish();
+    return file.close() && std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+  } catch (cl::Error error) {
+    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+    return false;
+  }
+}
+
+bool CLRenderer::loadCheckpoint(const std::string &filename) {
+  MappedFile file(filename);
+  if (!file.isOpen() || file.getSize() < sizeof(CheckpointHeader))
+    return false;
+  CheckpointHeader header;
+  std::memcpy(&header, file.getData(), sizeof(header));
+  const size_t pixelCount = width * height;
+  const size_t rawOffset = sizeof(CheckpointHeader);
+  const size_t momentOffset = rawOffset + pixelCount * sizeof(cl_float4);
+  if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.width != width || header.height != height ||
+      file.getSize() != momentOffset + pixelCount * sizeof(cl_float)) {
+    std::cerr << "[CLRenderer] " << filename << " is no checkpoint of a " << width << "x" << height
+              << " image" << std::endl;
+    return false;
+  }
+  try {
+    finish();
+    queue.enqueueWriteBuffer(imageRawBuffer, CL_FALSE, 0, pixelCount * sizeof(cl_float4),
+                             file.getData() + rawOffset);
+    queue.enqueueWriteBuffer(imageMomentBuffer, CL_FALSE, 0, pixelCount * sizeof(cl_float),
+                             file.getData() + momentOffset);
+    queue.finish();
+  } catch (cl::Error error) {
+    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+    return false;
+  }
+  // the next pass continues the accumulation of the checkpoint
+  sampleCount = header.sampleCount;
+  nextSampleIndex = header.sampleIndex;
+  rowOffset = 0;
+  sizeChanged = false;
+  adaptivePass = false;
+  vMatrix = passVMatrix = header.vMatrix;
+  fov = passFov = header.fov;
+  passWidth = width;
+  passHeight = height;
+  // the hit positions and the cone prepass weren't stored
+  historyValid = false;
+  coneStartValid = false;
+  return true;
+}
+
+cl::Event CLRenderer::getRawImageAsync(std::vector<float> &pixels) {
+  pixels.resize(width * height * 4);
+  cl::Event done;
+  queue.enqueueReadBuffer(imageRawBuffer, CL_FALSE, 0, width * height * sizeof(cl_float4),
+                          &(pixels[0]), nullptr, &done);
+  queue.flush();
+  return done;
+}
+
+std::vector<float> CLRenderer::getRawImage(size_t firstRow, size_t rowCount) {
+  std::vector<float> retVal(width * rowCount * 4);
+  queue.enqueueReadBuffer(imageRawBuffer, CL_TRUE, firstRow * width * sizeof(cl_float4),
+                          width * rowCount * sizeof(cl_float4), &(retVal[0]));
+  return retVal;
+}
+
+std::vector<float> CLRenderer::getTargetRows(size_t firstRow, size_t rowCount) {
+  std::vector<float> retVal(width * rowCount * 4);
+  cl::size_t<3> origin;
+  origin[1] = firstRow;
+  cl::size_t<3> region;
+  region[0] = width;
+  region[1] = rowCount;
+  region[2] = 1;
+  queue.enqueueReadImage(getTargetImage(), CL_TRUE, origin, region, 0, 0, &(retVal[0]));
+  return retVal;
+}
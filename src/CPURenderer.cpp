@@ -0,0 +1,288 @@
+#include "CPURenderer.hpp"
+#include "ImageIO.hpp"
+#include <algorithm>
+#include <cmath>
+
+/********** host versions of the functions in the opencl kernels **********/
+
+// the scenes are the ones of the baseline kernels with their default parameters, they don't read
+// SceneParams and march with the fixed precision, without the level of detail of the iterations,
+// the footprint tolerance, the relaxation and the bounding volumes, so the images only approximate
+// the ones of the opencl kernels
+
+struct Ray {
+  glm::vec3 origin;
+  glm::vec3 dir;
+};
+
+// combined Tausworthe and LCG generator, which the opencl kernels used before the counter based
+// generator of kernels/sampler.cl
+static inline uint32_t tausStep(uint32_t &z, int S1, int S2, int S3, uint32_t M) {
+  uint32_t b = (((z << S1) ^ z) >> S2);
+  return z = (((z & M) << S3) ^ b);
+}
+
+static inline uint32_t lcgStep(uint32_t &z, uint32_t A, uint32_t C) { return z = (A * z + C); }
+
+static inline float rand(glm::uvec4 &z) {
+  return 2.3283064365387e-10f * (float)(tausStep(z.x, 13, 19, 12, 4294967294u) ^
+                                        tausStep(z.y, 2, 25, 4, 4294967288u) ^
+                                        tausStep(z.z, 3, 11, 17, 4294967280u) ^
+                                        lcgStep(z.w, 1664525, 1013904223));
+}
+
+// see kernels/raymarch_menger.cl
+struct MengerScene {
+  static constexpr float MAX_SCENE_BOUNDS = 1000.0f;
+  static constexpr int MAX_RAYMARCH_STEPS = 1500;
+  static constexpr float RAYMARCH_PRECISION = 0.000001f;
+  static constexpr float PIXEL_JITTER = 0.5f;
+
+  static float DE(glm::vec3 pos) {
+    const float scale = 3.0f;
+    const float scaleM = 3.0f - 1.0f;
+    const glm::vec3 offset(1.0f, 1.0f, 1.0f);
+    const int iters = 10;
+    const float psni = std::pow(scale, -(float)iters);
+    for (int n = 0; n < iters; n++) {
+      pos = glm::abs(pos);
+      if (pos.x < pos.y)
+        std::swap(pos.x, pos.y);
+      if (pos.x < pos.z)
+        std::swap(pos.x, pos.z);
+      if (pos.y < pos.z)
+        std::swap(pos.y, pos.z);
+
+      pos = pos * scale - offset * scaleM;
+      if (pos.z < -0.5f * offset.z * scaleM)
+        pos.z += offset.z * scaleM;
+    }
+    // DEBox
+    return (std::max(std::abs(pos.x), std::max(std::abs(pos.y), std::abs(pos.z))) -
+            scale * 0.3333334f) *
+           psni;
+  }
+
+  static glm::vec3 shade(const Ray &ray, float t, int steps, glm::uvec4 &randState);
+};
+
+// see kernels/raymarch_kaleido.cl
+struct KaleidoScene {
+  static constexpr float MAX_SCENE_BOUNDS = 100000.0f;
+  static constexpr int MAX_RAYMARCH_STEPS = 250;
+  static constexpr float RAYMARCH_PRECISION = 0.0000001f;
+  static constexpr float PIXEL_JITTER = 1.0f;
+  static constexpr int KIFS_ITERATIONS = 40;
+
+  /**
+   * the transformation of one KIFS iteration, the columns are the rows of 'calc_transform'
+   */
+  static glm::mat4 calcTransform(glm::vec3 offset, glm::vec3 axis, float angle, float scale) {
+    angle = glm::radians(angle);
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    const glm::vec3 t = (1.0f - c) * axis;
+    return glm::mat4(
+        glm::vec4(c + t.x * axis.x, t.y * axis.x - s * axis.z, t.z * axis.x + s * axis.y, 0.0f) *
+            scale,
+        glm::vec4(t.x * axis.y + s * axis.z, c + t.y * axis.y, t.z * axis.y - s * axis.x, 0.0f) *
+            scale,
+        glm::vec4(t.x * axis.z - s * axis.y, t.y * axis.z + s * axis.x, c + t.z * axis.z, 0.0f) *
+            scale,
+        glm::vec4(offset, 1.0f));
+  }
+
+  static float DE(glm::vec3 p) {
+    static const glm::mat4 m = calcTransform(
+        glm::vec3(-0.4f, -0.9f, -0.49f), glm::normalize(glm::vec3(1.0f, 1.0f, 2.1f)), 40.0f, 1.5f);
+    static const float iterationScale = std::pow(1.5f, -(float)KIFS_ITERATIONS);
+    for (int i = 0; i < KIFS_ITERATIONS; i++)
+      p = glm::vec3(m * glm::vec4(glm::abs(p), 0.3f));
+    return (glm::length(p) - 1.0f) * iterationScale;
+  }
+
+  static glm::vec3 shade(const Ray &ray, float t, int steps, glm::uvec4 &randState);
+};
+
+template <typename Scene> static glm::vec3 calcNormal(const glm::vec3 &pos) {
+  const float eps = Scene::RAYMARCH_PRECISION;
+  const glm::vec3 epsX(eps, 0.0f, 0.0f);
+  const glm::vec3 epsY(0.0f, eps, 0.0f);
+  const glm::vec3 epsZ(0.0f, 0.0f, eps);
+  return glm::normalize(glm::vec3(Scene::DE(pos + epsX) - Scene::DE(pos - epsX),
+                                  Scene::DE(pos + epsY) - Scene::DE(pos - epsY),
+                                  Scene::DE(pos + epsZ) - Scene::DE(pos - epsZ)));
+}
+
+template <typename Scene> static int march(const Ray &ray, float &t) {
+  t = Scene::RAYMARCH_PRECISION * 3.0f;
+  int steps = -1;
+  for (int i = 0; i < Scene::MAX_RAYMARCH_STEPS; ++i) {
+    float dis = Scene::DE(ray.origin + ray.dir * t);
+    if (dis < Scene::RAYMARCH_PRECISION || t > Scene::MAX_SCENE_BOUNDS)
+      break;
+    t += dis;
+    steps = i;
+  }
+  if (t > Scene::MAX_SCENE_BOUNDS)
+    return -1;
+  return steps;
+}
+
+template <typename Scene>
+static float calcAO(const glm::vec3 &pos, const glm::vec3 &nor, glm::uvec4 &randState) {
+  float totao = 0.0f;
+  for (int aoi = 0; aoi < 8; aoi++) {
+    glm::vec3 aopos = -1.0f + 2.0f * glm::vec3(rand(randState), rand(randState), rand(randState));
+    aopos *= glm::sign(glm::dot(aopos, nor));
+    aopos = pos + nor * 0.01f + aopos * 0.04f;
+    totao += glm::clamp(Scene::DE(aopos) * 4.0f, 0.0f, 1.0f);
+  }
+  totao /= 8.0f;
+  return glm::clamp(totao * totao * 50.0f, 0.0f, 1.0f);
+}
+
+template <typename Scene>
+static float softshadow(const Ray &toLightRay, const float mint, const float maxt, const float k) {
+  float res = 1.0f;
+  int steps = 0;
+  for (float t = mint; t < maxt && steps < Scene::MAX_RAYMARCH_STEPS;) {
+    float h = Scene::DE(toLightRay.origin + toLightRay.dir * t);
+    if (h < Scene::RAYMARCH_PRECISION)
+      return 0.0f;
+    res = std::min(res, k * h / t);
+    t += h;
+    steps++;
+  }
+  return res;
+}
+
+glm::vec3 MengerScene::shade(const Ray &ray, float t, int steps, glm::uvec4 &randState) {
+  return glm::vec3(1.0f, 0.9f, 0.8f) * 1.0f / std::max(steps * 0.1f, 1.0f);
+}
+
+glm::vec3 KaleidoScene::shade(const Ray &ray, float t, int steps, glm::uvec4 &randState) {
+  const glm::vec3 light(2.0f, -4.0f, -9.0f);
+  const glm::vec3 matColor(1.0f, 1.0f, 1.0f);
+  const glm::vec3 lightColor = 19.0f * glm::vec3(1.0f, 0.9f, 0.8f);
+
+  const glm::vec3 pos = ray.origin + ray.dir * t;
+  const glm::vec3 normal = calcNormal<KaleidoScene>(pos);
+  const glm::vec3 lPos = light - pos;
+  const float llen = glm::length(lPos);
+  const glm::vec3 lPosNorm = glm::normalize(lPos);
+  const Ray shadowRay = {pos, lPosNorm};
+  return std::max(0.07f, softshadow<KaleidoScene>(shadowRay, 2.0f * RAYMARCH_PRECISION,
+                                                  MAX_SCENE_BOUNDS, 4.0f)) *
+         matColor * lightColor * std::max(0.3f, glm::dot(lPosNorm, normal)) * 1.0f /
+         (llen * llen * 0.03f) *
+         std::pow(calcAO<KaleidoScene>(pos, normal, randState), 1.0f / 2.2f);
+}
+
+template <typename Scene> static glm::vec3 trace(const Ray &ray, glm::uvec4 &randState) {
+  float t;
+  int steps;
+  if ((steps = march<Scene>(ray, t)) != -1)
+    return Scene::shade(ray, t, steps, randState);
+  return glm::vec3(0.0f);
+}
+
+/********** CPURenderer **********/
+
+CPURenderer::CPURenderer(size_t width, size_t height, Scene scene, size_t threadCount)
+    : sampleCount(0), samplesPerLaunch(1), vMatrix(1.0f), fov(1.0f), scene(scene),
+      scheduler(threadCount) {
+  reshape(width, height);
+}
+
+template <typename SceneT> void CPURenderer::renderTile(size_t tile) {
+  const size_t tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  const size_t startX = (tile % tilesX) * TILE_SIZE;
+  const size_t startY = (tile / tilesX) * TILE_SIZE;
+  const size_t endX = std::min(startX + TILE_SIZE, width);
+  const size_t endY = std::min(startY + TILE_SIZE, height);
+  const float invWidth = 1.0f / (float)width;
+  const glm::vec3 origin = glm::vec3(vMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+  for (size_t y = startY; y < endY; ++y) {
+    for (size_t x = startX; x < endX; ++x) {
+      const size_t imgIndex = y * width + x;
+      glm::uvec4 &r = randStates[imgIndex];
+      glm::vec4 val = sampleCount > samplesPerLaunch ? imageRaw[imgIndex] : glm::vec4(0.0f);
+      for (size_t i = 0; i < samplesPerLaunch; ++i) {
+        // tent filter
+        const float r1 = 2.0f * rand(r);
+        const float dx = r1 < 1.0f ? std::sqrt(r1) - 1.0f : 1.0f - std::sqrt(2.0f - r1);
+        const float r2 = 2.0f * rand(r);
+        const float dy = r2 < 1.0f ? std::sqrt(r2) - 1.0f : 1.0f - std::sqrt(2.0f - r2);
+        const float u = ((float)x + 0.5f + dx * SceneT::PIXEL_JITTER) * invWidth * 2.0f - 1.0f;
+        const float v = ((float)y + 0.5f + dy * SceneT::PIXEL_JITTER) * invWidth * 2.0f -
+                        (float)height / (float)width;
+        const glm::vec3 dir = glm::vec3(
+            vMatrix * glm::vec4(glm::normalize(glm::vec3(u, v, std::min(-fov, -0.0001f))), 0.0f));
+        const Ray ray = {origin, dir};
+        val += glm::vec4(trace<SceneT>(ray, r), 1.0f);
+      }
+      imageRaw[imgIndex] = val;
+    }
+  }
+}
+
+void CPURenderer::render(bool refresh) {
+  sampleCount = refresh ? samplesPerLaunch : (sampleCount + samplesPerLaunch);
+  const size_t tileCount =
+      ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+  switch (scene) {
+  case MENGER:
+    scheduler.run(tileCount, [this](size_t tile) { renderTile<MengerScene>(tile); });
+    break;
+  case KALEIDO:
+    scheduler.run(tileCount, [this](size_t tile) { renderTile<KaleidoScene>(tile); });
+    break;
+  }
+}
+
+void CPURenderer::reshape(size_t width, size_t height) {
+  this->width = width;
+  this->height = height;
+  imageRaw.assign(width * height, glm::vec4(0.0f));
+  randStates.resize(width * height);
+  // every pixel has its own state, the generator isn't the one of the opencl kernels, so the
+  // samples differ from theirs
+  for (size_t i = 0; i < width * height; ++i)
+    randStates[i] = glm::uvec4(4 * i + 0, 4 * i + 1, 4 * i + 2, 4 * i + 3);
+  sampleCount = 0;
+}
+
+void CPURenderer::finish() {
+  // 'render' is blocking, so there is nothing to wait for
+}
+
+void CPURenderer::setSamplesPerLaunch(size_t samplesPerLaunch) {
+  this->samplesPerLaunch = std::max<size_t>(1, samplesPerLaunch);
+}
+
+void CPURenderer::setVMatrix(glm::mat4 m) { vMatrix = m; }
+
+void CPURenderer::setFov(float fov) { this->fov = fov; }
+
+size_t CPURenderer::getSampleCount() const { return sampleCount; }
+
+size_t CPURenderer::getWidth() const { return width; }
+
+size_t CPURenderer::getHeight() const { return height; }
+
+size_t CPURenderer::getThreadCount() const { return scheduler.getThreadCount(); }
+
+std::vector<uint8_t> CPURenderer::getImage() {
+  // the vec4 pixels are tightly packed floats in RGBA order
+  return imageio::tonemap(&imageRaw[0].x, width * height);
+}
+
+std::vector<float> CPURenderer::getRawImage() {
+  std::vector<float> retVal(width * height * 4);
+  for (size_t i = 0; i < width * height; ++i)
+    for (int c = 0; c < 4; ++c)
+      retVal[i * 4 + c] = imageRaw[i][c];
+  return retVal;
+}
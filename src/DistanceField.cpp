@@ -0,0 +1,96 @@
+#include "DistanceField.hpp"
+#include "CLUtils.hpp"
+#include "MappedFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char DISTANCE_FIELD_MAGIC[8] = {'P', 'M', 'C', 'L', 'D', 'F', 'D', '1'};
+
+DistanceField::DistanceField(const cl::Context &context, cl::CommandQueue &queue,
+                             const cl::Program &program, uint64_t programHash,
+                             const cl::Buffer &sceneParamsBuffer, const cl_scene_params &params,
+                             size_t resolution, const std::string &directory)
+    : resolution(resolution) {
+  if (!directory.empty()) {
+    // the padding of the parameters is zeroed by 'SceneParams::toCL', so it doesn't change the key
+    std::ostringstream keySource;
+    keySource << programHash << '\0' << resolution << '\0'
+              << std::string((const char *)&params, sizeof(params));
+    std::ostringstream name;
+    name << directory << "/field-" << std::hex << std::setw(16) << std::setfill('0')
+         << ProgramCache::hash(keySource.str()) << ".bin";
+    filename = name.str();
+    if (load(context))
+      return;
+  }
+
+  const size_t cellCount = resolution * resolution * resolution;
+  buffer = cl::Buffer(context, CL_MEM_READ_WRITE, cellCount * sizeof(cl_float));
+  cl::make_kernel<cl::Buffer &, cl_int, const cl::Buffer &> bake(
+      cl::Kernel(program, "bakeDistanceField"));
+  const cl::NDRange globalSize(cl::nextDivisible(resolution, 4), cl::nextDivisible(resolution, 4),
+                               cl::nextDivisible(resolution, 4));
+  bake(cl::EnqueueArgs(queue, globalSize, cl::NDRange(4, 4, 4)), buffer, this->resolution,
+       sceneParamsBuffer);
+  std::cout << "[DistanceField] baked " << resolution << "^3 cells" << std::endl;
+  store(queue);
+}
+
+bool DistanceField::load(const cl::Context &context) {
+  MappedFile file(filename);
+  const size_t cellCount = (size_t)resolution * resolution * resolution;
+  if (!file.isOpen() ||
+      file.getSize() != sizeof(DistanceFieldHeader) + cellCount * sizeof(cl_float))
+    return false;
+  DistanceFieldHeader header;
+  std::memcpy(&header, file.getData(), sizeof(header));
+  if (std::memcmp(header.magic, DISTANCE_FIELD_MAGIC, sizeof(header.magic)) != 0 ||
+      header.resolution != (cl_uint)resolution)
+    return false;
+  buffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                      cellCount * sizeof(cl_float),
+                      (void *)(file.getData() + sizeof(DistanceFieldHeader)));
+  return true;
+}
+
+void DistanceField::store(cl::CommandQueue &queue) const {
+  if (filename.empty())
+    return;
+  // creates the cache directory and its parents, see 'ProgramCache::store'
+  for (size_t pos = filename.find('/', 1); pos != std::string::npos;
+       pos = filename.find('/', pos + 1))
+    mkdir(filename.substr(0, pos).c_str(), 0755);
+
+  // the field is read directly into a temporary file, so concurrent processes never load a
+  // partial field
+  const size_t cellCount = (size_t)resolution * resolution * resolution;
+  const std::string tmpFilename = filename + ".tmp" + std::to_string(getpid());
+  {
+    MappedFile file(tmpFilename, sizeof(DistanceFieldHeader) + cellCount * sizeof(cl_float));
+    if (!file.isOpen()) {
+      std::remove(tmpFilename.c_str());
+      return;
+    }
+    DistanceFieldHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DISTANCE_FIELD_MAGIC, sizeof(header.magic));
+    header.resolution = resolution;
+    std::memcpy(file.getData(), &header, sizeof(header));
+    queue.enqueueReadBuffer(buffer, CL_TRUE, 0, cellCount * sizeof(cl_float),
+                            file.getData() + sizeof(DistanceFieldHeader));
+    if (!file.close()) {
+      std::remove(tmpFilename.c_str());
+      return;
+    }
+  }
+  std::rename(tmpFilename.c_str(), filename.c_str());
+}
+
+const cl::Buffer &DistanceField::getBuffer() const { return buffer; }
+
+cl_int DistanceField::getResolution() const { return resolution; }
@@ -0,0 +1,176 @@
+#include "ImageIO.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace imageio {
+bool writePPM(const std::string &filename, size_t width, size_t height,
+              const std::vector<uint8_t> &pixels) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open() || pixels.size() < width * height * 4)
+    return false;
+  file << "P6\n" << width << " " << height << "\n255\n";
+  std::vector<uint8_t> row(width * 3);
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x)
+      for (size_t c = 0; c < 3; ++c)
+        row[x * 3 + c] = pixels[(y * width + x) * 4 + c];
+    file.write((const char *)row.data(), row.size());
+  }
+  return file.good();
+}
+
+bool writeBMP(const std::string &filename, size_t width, size_t height,
+              const std::vector<uint8_t> &pixels) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open() || pixels.size() < width * height * 4)
+    return false;
+  // the rows are padded to multiples of 4 bytes
+  const size_t rowSize = (width * 3 + 3) / 4 * 4;
+  const uint32_t headerSize = 54;
+  const uint32_t fields[] = {(uint32_t)(headerSize + rowSize * height), 0, headerSize, 40,
+                             (uint32_t)width, (uint32_t)height};
+  file.write("BM", 2);
+  // all fields are little endian
+  auto writeField = [&file](uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i)
+      file.put((char)((value >> (8 * i)) & 0xFF));
+  };
+  for (uint32_t field : fields)
+    writeField(field, 4);
+  writeField(1, 2);                            // planes
+  writeField(24, 2);                           // bits per pixel
+  writeField(0, 4);                            // no compression
+  writeField((uint32_t)(rowSize * height), 4); // the size of the pixel data
+  writeField(2835, 4);                         // 72 dpi
+  writeField(2835, 4);
+  writeField(0, 4); // no palette
+  writeField(0, 4);
+  std::vector<uint8_t> row(rowSize, 0);
+  // bmp stores the rows from bottom to top in BGR order
+  for (size_t y = height; y-- > 0;) {
+    for (size_t x = 0; x < width; ++x)
+      for (size_t c = 0; c < 3; ++c)
+        row[x * 3 + c] = pixels[(y * width + x) * 4 + 2 - c];
+    file.write((const char *)row.data(), row.size());
+  }
+  return file.good();
+}
+
+bool writePFM(const std::string &filename, size_t width, size_t height,
+              const std::vector<float> &pixels, float scale) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open() || pixels.size() < width * height * 4)
+    return false;
+  // a negative scale marks little endian data
+  file << "PF\n" << width << " " << height << "\n-1.0\n";
+  std::vector<float> row(width * 3);
+  // pfm stores the rows from bottom to top
+  for (size_t y = height; y-- > 0;) {
+    for (size_t x = 0; x < width; ++x)
+      for (size_t c = 0; c < 3; ++c)
+        row[x * 3 + c] = pixels[(y * width + x) * 4 + c] * scale;
+    file.write((const char *)row.data(), row.size() * sizeof(float));
+  }
+  return file.good();
+}
+
+/**
+ * returns the header of a PFM or PPM file
+ */
+static std::string imageHeader(size_t width, size_t height, MappedImage::Format format) {
+  std::ostringstream header;
+  // a negative scale marks little endian data
+  if (format == MappedImage::PFM)
+    header << "PF\n" << width << " " << height << "\n-1.0\n";
+  else
+    header << "P6\n" << width << " " << height << "\n255\n";
+  return header.str();
+}
+
+MappedImage::MappedImage(const std::string &filename, size_t width, size_t height,
+                         Format format)
+    : format(format), width(width), height(height),
+      headerSize(imageHeader(width, height, format).size()),
+      file(filename, headerSize + width * height * (format == PFM ? 3 * sizeof(float) : 3)) {
+  if (file.isOpen())
+    std::memcpy(file.getData(), imageHeader(width, height, format).data(), headerSize);
+}
+
+size_t MappedImage::pixelSize() const { return format == PFM ? 3 * sizeof(float) : 3; }
+
+size_t MappedImage::pixelOffset(size_t x, size_t y) const {
+  // pfm stores the rows from bottom to top
+  const size_t row = format == PFM ? height - 1 - y : y;
+  return headerSize + (row * width + x) * pixelSize();
+}
+
+bool MappedImage::isOpen() const { return file.isOpen(); }
+
+void MappedImage::writeTile(size_t x, size_t y, size_t tileWidth, size_t tileHeight,
+                            const float *pixels) {
+  if (!isOpen())
+    return;
+  for (size_t ty = 0; ty < tileHeight; ++ty) {
+    uint8_t *row = file.getData() + pixelOffset(x, y + ty);
+    for (size_t tx = 0; tx < tileWidth; ++tx) {
+      const float *pixel = pixels + (ty * tileWidth + tx) * 4;
+      // the w component contains the count of samples of this pixel
+      const float count = std::max(pixel[3], 1.0f);
+      for (size_t c = 0; c < 3; ++c) {
+        const float value = pixel[c] / count;
+        if (format == PFM)
+          std::memcpy(row + (tx * 3 + c) * sizeof(float), &value, sizeof(float));
+        else
+          row[tx * 3 + c] = tonemapChannel(value);
+      }
+    }
+  }
+}
+
+void MappedImage::releaseRows(size_t firstRow, size_t rowCount) {
+  if (rowCount == 0)
+    return;
+  // the rows of a pfm file are stored in the reverse order
+  const size_t lastRow = firstRow + rowCount - 1;
+  const size_t begin = pixelOffset(0, format == PFM ? lastRow : firstRow);
+  file.release(begin, rowCount * width * pixelSize());
+}
+
+bool MappedImage::close() { return file.close(); }
+
+uint8_t tonemapChannel(float value) {
+  return (uint8_t)(std::min(std::max(std::pow(value / (value + 1.0f), 1.0f / 2.2f), 0.0f), 1.0f) *
+                   255.0f);
+}
+
+std::vector<uint8_t> tonemap(const float *pixels, size_t pixelCount) {
+  std::vector<uint8_t> retVal(pixelCount * 4);
+  for (size_t i = 0; i < pixelCount * 4; i += 4) {
+    // the w component contains the count of samples of this pixel
+    const float count = std::max(pixels[i + 3], 1.0f);
+    for (size_t c = 0; c < 3; ++c)
+      retVal[i + c] = tonemapChannel(pixels[i + c] / count);
+    retVal[i + 3] = 255;
+  }
+  return retVal;
+}
+
+void normalizeSamples(std::vector<float> &pixels) {
+  for (size_t i = 0; i + 3 < pixels.size(); i += 4) {
+    const float count = std::max(pixels[i + 3], 1.0f);
+    for (size_t c = 0; c < 4; ++c)
+      pixels[i + c] /= count;
+  }
+}
+
+bool hasExtension(const std::string &filename, const std::string &extension) {
+  if (filename.size() < extension.size())
+    return false;
+  return std::equal(extension.rbegin(), extension.rend(), filename.rbegin(),
+                    [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+}
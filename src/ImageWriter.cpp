@@ -0,0 +1,72 @@
+#include "ImageWriter.hpp"
+#include "ImageIO.hpp"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+ImageWriter::ImageWriter(size_t maxJobs) : maxJobs(std::max<size_t>(1, maxJobs)), quit(false) {
+  thread = std::thread(&ImageWriter::workerLoop, this);
+}
+
+ImageWriter::~ImageWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  condition.notify_one();
+  thread.join();
+}
+
+void ImageWriter::workerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return quit || !jobs.empty(); });
+      if (jobs.empty())
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+bool ImageWriter::submit(const std::function<void()> &job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.size() >= maxJobs)
+      return false;
+    jobs.push_back(job);
+  }
+  condition.notify_one();
+  return true;
+}
+
+bool ImageWriter::submit(const std::string &filename,
+                         const std::shared_ptr<CLRenderer::PinnedImage> &image) {
+  const bool submitted = submit([filename, image]() {
+    const size_t width = image->getWidth();
+    const size_t height = image->getHeight();
+    bool written;
+    if (image->isHDR()) {
+      const float *pixels = (const float *)image->getPixels();
+      std::vector<float> normalized(pixels, pixels + width * height * 4);
+      image->release();
+      imageio::normalizeSamples(normalized);
+      written = imageio::writePFM(filename, width, height, normalized);
+    } else {
+      const uint8_t *pixels = (const uint8_t *)image->getPixels();
+      const std::vector<uint8_t> rgba(pixels, pixels + width * height * 4);
+      image->release();
+      written = imageio::hasExtension(filename, ".bmp")
+                    ? imageio::writeBMP(filename, width, height, rgba)
+                    : imageio::writePPM(filename, width, height, rgba);
+    }
+    if (!written)
+      std::cerr << "[ImageWriter] could not write " << filename << std::endl;
+  });
+  if (!submitted)
+    image->release();
+  return submitted;
+}
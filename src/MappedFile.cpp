@@ -0,0 +1,66 @@
+#include "MappedFile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename, size_t size)
+    : fd(-1), data(nullptr), size(size) {
+  fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  // the file is sparse until it is written
+  if (ftruncate(fd, size) != 0)
+    return;
+  void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping != MAP_FAILED)
+    data = (uint8_t *)mapping;
+}
+
+MappedFile::MappedFile(const std::string &filename) : fd(-1), data(nullptr), size(0) {
+  fd = open(filename.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+    return;
+  size = info.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapping != MAP_FAILED)
+    data = (uint8_t *)mapping;
+}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::isOpen() const { return data != nullptr; }
+
+uint8_t *MappedFile::getData() { return data; }
+
+const uint8_t *MappedFile::getData() const { return data; }
+
+size_t MappedFile::getSize() const { return size; }
+
+void MappedFile::release(size_t offset, size_t length) {
+  if (!isOpen())
+    return;
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  const size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+  const size_t end = (offset + length) / pageSize * pageSize;
+  if (begin >= end)
+    return;
+  // the pages stay in the page cache until they are written back, so nothing is lost
+  msync(data + begin, end - begin, MS_ASYNC);
+  madvise(data + begin, end - begin, MADV_DONTNEED);
+}
+
+bool MappedFile::close() {
+  bool written = data != nullptr;
+  if (data != nullptr) {
+    written = msync(data, size, MS_SYNC) == 0;
+    munmap(data, size);
+    data = nullptr;
+  }
+  if (fd >= 0) {
+    written = ::close(fd) == 0 && written;
+    fd = -1;
+  }
+  return written;
+}
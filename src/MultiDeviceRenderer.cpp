@@ -0,0 +1,189 @@
+#include "MultiDeviceRenderer.hpp"
+#include "ImageIO.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+MultiDeviceRenderer::MultiDeviceRenderer(
+    const std::vector<std::shared_ptr<CLRenderer>> &renderers)
+    : renderers(renderers), rowsPerSecond(renderers.size(), 0.0), bandRows(renderers.size(), 0),
+      splitHeight(0) {
+  if (renderers.size() == 0) {
+    std::cerr << "[MultiDeviceRenderer] no renderers given" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // the time of a frame has to contain the whole band of every device
+  for (auto &renderer : renderers)
+    renderer->setRowsPerLaunch(0);
+}
+
+MultiDeviceRenderer::MultiDeviceRenderer(size_t width, size_t height,
+                                         const std::string &kernelname,
+                                         const std::string &sourceFilename,
+                                         const std::string &buildOptions)
+    : splitHeight(0) {
+  const size_t deviceCount = CLRenderer::getAllDevices().size();
+  if (deviceCount == 0) {
+    std::cerr << "[MultiDeviceRenderer] no opencl devices available" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < deviceCount; ++i)
+    renderers.emplace_back(
+        new CLRenderer(width, height, kernelname, sourceFilename, buildOptions, i));
+  rowsPerSecond.assign(deviceCount, 0.0);
+  bandRows.assign(deviceCount, 0);
+}
+
+std::vector<size_t> MultiDeviceRenderer::computeSplit(size_t height) const {
+  const size_t count = renderers.size();
+  std::vector<size_t> rows(count, 0);
+  if (height < count * ROW_GRANULARITY) {
+    rows[0] = height;
+    return rows;
+  }
+  // without a measurement of every device all devices get the same share
+  const bool measured =
+      std::find(rowsPerSecond.begin(), rowsPerSecond.end(), 0.0) == rowsPerSecond.end();
+  double totalSpeed = 0.0;
+  for (size_t i = 0; i < count; ++i)
+    totalSpeed += measured ? rowsPerSecond[i] : 1.0;
+  size_t assigned = 0;
+  for (size_t i = 0; i + 1 < count; ++i) {
+    const double share = (measured ? rowsPerSecond[i] : 1.0) / totalSpeed;
+    // every device keeps at least one group of rows, so its speed is still measured
+    const size_t maxRows = height - assigned - (count - 1 - i) * ROW_GRANULARITY;
+    const size_t groups = (size_t)std::round(share * height / ROW_GRANULARITY);
+    rows[i] = std::min(maxRows, std::max<size_t>(1, groups) * ROW_GRANULARITY);
+    assigned += rows[i];
+  }
+  rows.back() = height - assigned;
+  return rows;
+}
+
+double MultiDeviceRenderer::estimateFrameTime(const std::vector<size_t> &rows) const {
+  double frameTime = 0.0;
+  for (size_t i = 0; i < rows.size(); ++i)
+    if (rows[i] > 0)
+      frameTime = std::max(frameTime, rows[i] / std::max(rowsPerSecond[i], 1.0e-9));
+  return frameTime;
+}
+
+void MultiDeviceRenderer::applySplit(const std::vector<size_t> &rows) {
+  size_t firstRow = 0;
+  for (size_t i = 0; i < renderers.size(); ++i) {
+    renderers[i]->setRowRange(firstRow, rows[i]);
+    firstRow += rows[i];
+  }
+  bandRows = rows;
+}
+
+void MultiDeviceRenderer::render(bool refresh) {
+  const size_t height = renderers[0]->getHeight();
+  const std::vector<size_t> split = computeSplit(height);
+  // a new band restarts the accumulation of the device, so the bands of an accumulated image
+  // only change if that pays off
+  if (refresh || height != splitHeight ||
+      estimateFrameTime(bandRows) > rebalanceGain * estimateFrameTime(split)) {
+    applySplit(split);
+    splitHeight = height;
+  }
+
+  std::vector<Clock::time_point> startTimes(renderers.size());
+  for (size_t i = 0; i < renderers.size(); ++i) {
+    startTimes[i] = Clock::now();
+    renderers[i]->render(refresh);
+  }
+  // every device is waited for by its own thread, so the time of every device is measured and
+  // not only the time of the slowest device
+  std::vector<double> frameTimes(renderers.size(), 0.0);
+  std::vector<std::thread> waiters;
+  for (size_t i = 0; i < renderers.size(); ++i)
+    waiters.emplace_back([this, i, &startTimes, &frameTimes]() {
+      renderers[i]->finish();
+      frameTimes[i] = (double)getPastTime(startTimes[i]) / 1.0e9;
+    });
+  for (auto &waiter : waiters)
+    waiter.join();
+
+  for (size_t i = 0; i < renderers.size(); ++i) {
+    if (bandRows[i] == 0 || frameTimes[i] <= 0.0)
+      continue;
+    // the speed is smoothed, so a single slow frame doesn't move the bands back and forth
+    const double speed = bandRows[i] / frameTimes[i];
+    rowsPerSecond[i] = rowsPerSecond[i] == 0.0 ? speed : 0.5 * (rowsPerSecond[i] + speed);
+  }
+}
+
+void MultiDeviceRenderer::reshape(size_t width, size_t height) {
+  for (auto &renderer : renderers)
+    renderer->reshape(width, height);
+  splitHeight = 0;
+}
+
+void MultiDeviceRenderer::setRenderSize(size_t width, size_t height) {
+  for (auto &renderer : renderers)
+    renderer->setRenderSize(width, height);
+}
+
+void MultiDeviceRenderer::finish() {
+  for (auto &renderer : renderers)
+    renderer->finish();
+}
+
+void MultiDeviceRenderer::setVMatrix(glm::mat4 m) {
+  for (auto &renderer : renderers)
+    renderer->setVMatrix(m);
+}
+
+void MultiDeviceRenderer::setFov(float fov) {
+  for (auto &renderer : renderers)
+    renderer->setFov(fov);
+}
+
+void MultiDeviceRenderer::setSceneParams(const SceneParams &params) {
+  for (auto &renderer : renderers)
+    renderer->setSceneParams(params);
+}
+
+void MultiDeviceRenderer::setSamplesPerLaunch(size_t samplesPerLaunch) {
+  for (auto &renderer : renderers)
+    renderer->setSamplesPerLaunch(samplesPerLaunch);
+}
+
+size_t MultiDeviceRenderer::getSampleCount() const {
+  size_t sampleCount = std::numeric_limits<size_t>::max();
+  for (auto &renderer : renderers)
+    if (renderer->getRangeRows() > 0)
+      sampleCount = std::min(sampleCount, renderer->getSampleCount());
+  return sampleCount;
+}
+
+size_t MultiDeviceRenderer::getWidth() const { return renderers[0]->getWidth(); }
+
+size_t MultiDeviceRenderer::getHeight() const { return renderers[0]->getHeight(); }
+
+const std::vector<std::shared_ptr<CLRenderer>> &MultiDeviceRenderer::getRenderers() const {
+  return renderers;
+}
+
+std::vector<uint8_t> MultiDeviceRenderer::getImage() {
+  const std::vector<float> imageRaw = getRawImage();
+  return imageio::tonemap(imageRaw.data(), imageRaw.size() / 4);
+}
+
+std::vector<float> MultiDeviceRenderer::getRawImage() {
+  const size_t width = getWidth();
+  std::vector<float> retVal(width * getHeight() * 4);
+  for (auto &renderer : renderers) {
+    const size_t rows = renderer->getRangeRows();
+    if (rows == 0)
+      continue;
+    const size_t firstRow = renderer->getRangeBegin();
+    const std::vector<float> band = renderer->getRawImage(firstRow, rows);
+    std::copy(band.begin(), band.end(), retVal.begin() + firstRow * width * 4);
+  }
+  return retVal;
+}
@@ -1,9 +1,7 @@
 #include "OCLRenderer.hpp"
 #include "CLUtils.hpp"
 #include <GL/glew.h>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 
 #ifdef __linux__
 
@@ -18,9 +16,8 @@
 #include <glm/ext.hpp>
 
 OCLRenderer::OCLRenderer(size_t width, size_t height, const std::string &renderKernelName,
-                         const std::string &sourceFilename)
-    : texture(Texture(width, height)), fov(1.0f) {
-  setVMatrix(glm::mat4());
+                         const std::string &sourceFilename, const std::string &buildOptions)
+    : CLRenderer(width, height), texture(width, height), createEventFromGLsync(nullptr) {
   try {
 #ifdef __APPLE__
     CGLContextObj glContext = CGLGetCurrentContext();
@@ -35,9 +32,10 @@ OCLRenderer::OCLRenderer(size_t width, size_t height, const std::string &renderK
       context.getInfo(CL_CONTEXT_DEVICES, &devices);
       if (devices.size() > 0) {
         device = devices[0];
-        queue = cl::CommandQueue(context, device);
+        queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+        setupGLSync();
         // open and compile the program
-        openProgram(sourceFilename, renderKernelName);
+        openProgram(sourceFilename, renderKernelName, buildOptions);
         // setup texture with the correct width and height
         reshape(width, height);
         return;
@@ -79,9 +77,10 @@ OCLRenderer::OCLRenderer(size_t width, size_t height, const std::string &renderK
       else
         continue; // not the desired device, try the next platform
       context = cl::Context(device, properties);
-      queue = cl::CommandQueue(context, device);
+      queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+      setupGLSync();
       // open and compile the program
-      openProgram(sourceFilename, renderKernelName);
+      openProgram(sourceFilename, renderKernelName, buildOptions);
       // setup texture with the correct width and height
       reshape(width, height);
       // all setup
@@ -100,112 +99,74 @@ OCLRenderer::OCLRenderer(size_t width, size_t height, const std::string &renderK
   }
 }
 
-bool OCLRenderer::openProgram(const std::string &filename, const std::string &renderKernelName) {
-  try {
-    std::ifstream sourcefile(filename);
-    std::string sourcecode(std::istreambuf_iterator<char>(sourcefile),
-                           (std::istreambuf_iterator<char>()));
-    cl::Program::Sources source(1, std::make_pair(sourcecode.c_str(), sourcecode.length() + 1));
-
-    // make program of the source code in the context
-    program = cl::Program(context, source);
-
-    // possibly some definitions for the kernel
-    std::stringstream kerneloptions;
-    kerneloptions << "-I kernels/";
-
-    // build program
-    std::vector<cl::Device> tmpdevices;
-    tmpdevices.push_back(device);
-    program.build(tmpdevices, kerneloptions.str().c_str());
+cl::Image &OCLRenderer::getTargetImage() { return glImageBuffer; }
 
-    renderKernelFunc.reset(
-        new cl::make_kernel<cl::ImageGL &, cl::Buffer &, cl::Buffer &, const cl::Buffer &, cl_int,
-                            cl_int, cl_int, cl_float>(
-            cl::Kernel(program, renderKernelName.c_str())));
-    tonemapKernelFunc.reset(
-        new cl::make_kernel<const cl::Buffer &, cl::Buffer &, cl_int, cl_int, cl_float, cl_float>(
-            cl::Kernel(program, "tonemapSimpleReinhard")));
-  } catch (cl::Error error) {
-    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
+OCLRenderer::~OCLRenderer() {
+  finish();
+  for (auto &sync : glSyncs)
+    if (sync)
+      glDeleteSync(sync);
+}
 
-    if (error.err() == CL_BUILD_PROGRAM_FAILURE)
-      std::cerr << "Build log:" << std::endl
-                << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+void OCLRenderer::setupGLSync() {
+  const std::string extensions = device.getInfo<CL_DEVICE_EXTENSIONS>();
+  if (extensions.find("cl_khr_gl_event") == std::string::npos)
+    return;
+#ifdef CL_VERSION_1_2
+  cl::Platform platform(device.getInfo<CL_DEVICE_PLATFORM>());
+  createEventFromGLsync = (clCreateEventFromGLsyncKHR_fn)clGetExtensionFunctionAddressForPlatform(
+      platform(), "clCreateEventFromGLsyncKHR");
+#else
+  createEventFromGLsync =
+      (clCreateEventFromGLsyncKHR_fn)clGetExtensionFunctionAddress("clCreateEventFromGLsyncKHR");
+#endif
+}
 
-    exit(EXIT_FAILURE);
+void OCLRenderer::acquireTargetImage() {
+  if (createEventFromGLsync != nullptr) {
+    if (glSyncs.size() != frames.size()) {
+      for (auto &sync : glSyncs)
+        if (sync)
+          glDeleteSync(sync);
+      glSyncs.assign(frames.size(), nullptr);
+    }
+    // the frame that used this sync object before is already done
+    GLsync &sync = glSyncs[currentFrame];
+    if (sync)
+      glDeleteSync(sync);
+    sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    cl_int error;
+    cl_event syncEvent = createEventFromGLsync(context(), (cl_GLsync)sync, &error);
+    if (error == CL_SUCCESS) {
+      // opencl waits on the device for the opengl commands, instead of blocking the host
+      std::vector<cl::Event> waitEvents(1, cl::Event(syncEvent));
+      queue.enqueueAcquireGLObjects(&glObjs, &waitEvents);
+      return;
+    }
   }
-  return true;
+  glFinish();
+  queue.enqueueAcquireGLObjects(&glObjs);
 }
 
-void OCLRenderer::render(bool refresh) {
-  glFinish();
-  try {
-    queue.enqueueAcquireGLObjects(&glObjs);
-    cl::EnqueueArgs eargs(queue, cl::NDRange(cl::nextDivisible(texture.width, 8),
-                                             cl::nextDivisible(texture.height, 8)),
-                          cl::NDRange(8, 8));
-    cl::Buffer vMatrixBuffer(context, CL_MEM_READ_ONLY, sizeof(cl_float3x4));
-    queue.enqueueWriteBuffer(vMatrixBuffer, CL_TRUE, 0, sizeof(cl_float3x4), &vMatrix);
-    sampleCount = refresh ? 1 : (sampleCount + 1);
-    (*renderKernelFunc)(eargs, imageBuffer, imageRawBuffer, randStatesBuffer, vMatrixBuffer,
-                        texture.width, texture.height, sampleCount, fov);
-    queue.enqueueReleaseGLObjects(&glObjs);
+void OCLRenderer::releaseTargetImage() {
+  queue.enqueueReleaseGLObjects(&glObjs);
+  // with cl_khr_gl_event the release implicitly synchronizes with subsequent opengl commands
+  if (createEventFromGLsync == nullptr)
     queue.finish();
-  } catch (cl::Error error) {
-    std::cerr << error.what() << "(" << cl::errorString(error.err()) << ")" << std::endl;
-    exit(EXIT_FAILURE);
-  }
 }
 
-void OCLRenderer::reshape(size_t width, size_t height) {
+void OCLRenderer::reshapeTargetImage(size_t width, size_t height) {
   texture.width = width;
   texture.height = height;
   texture.createEmptyTexture();
 #ifdef CL_VERSION_1_2
-  imageBuffer = cl::ImageGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, texture.id);
+  glImageBuffer = cl::ImageGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, texture.id);
 #else
-  imageBuffer = cl::Image2DGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, texture.id);
+  glImageBuffer = cl::Image2DGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, texture.id);
 #endif
-  imageRawBuffer = cl::Buffer(context, CL_MEM_READ_ONLY, width * height * sizeof(cl_float4));
-  randStatesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY, width * height * sizeof(cl_uint4));
-  cl_uint *randStatesInitial = new cl_uint[4 * width * height];
-  for (size_t i = 0; i < 4 * width * height; ++i)
-    randStatesInitial[i] = i;
-  queue.enqueueWriteBuffer(randStatesBuffer, CL_TRUE, 0, width * height * sizeof(cl_uint4),
-                           randStatesInitial);
-  delete[] randStatesInitial;
   glObjs.clear();
-  glObjs.push_back(imageBuffer);
+  glObjs.push_back(glImageBuffer);
 }
 
 const Texture &OCLRenderer::getTexture() const { return texture; }
-
-void OCLRenderer::setVMatrix(cl_float3x4 m) { vMatrix = m; }
-
-void OCLRenderer::setVMatrix(glm::mat4 m) {
-  vMatrix = {{{{m[0][0], m[1][0], m[2][0], m[3][0]}},
-              {{m[0][1], m[1][1], m[2][1], m[3][1]}},
-              {{m[0][2], m[1][2], m[2][2], m[3][2]}}}};
-}
-
-void OCLRenderer::setFov(cl_float fov) { this->fov = fov; }
-
-size_t OCLRenderer::getSampleCount() const { return sampleCount; }
-
-std::vector<uint8_t> OCLRenderer::getImage() {
-  std::vector<uint8_t> retVal(texture.width * texture.height * 4);
-  glFinish();
-  cl::EnqueueArgs eargs(
-      queue, cl::NDRange(cl::nextDivisible(texture.width, 8), cl::nextDivisible(texture.height, 8)),
-      cl::NDRange(8, 8));
-
-  cl::Buffer tonemappedBuffer(context, CL_MEM_READ_ONLY,
-                              texture.width * texture.height * sizeof(cl_uchar4));
-  (*tonemapKernelFunc)(eargs, imageRawBuffer, tonemappedBuffer, texture.width, texture.height,
-                       (cl_float)sampleCount, 1.0f);
-  queue.enqueueReadBuffer(tonemappedBuffer, CL_TRUE, 0,
-                          texture.width * texture.height * sizeof(cl_uchar4), &(retVal[0]));
-  queue.finish();
-  return retVal;
-}
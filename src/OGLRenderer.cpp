@@ -1,8 +1,13 @@
 #include "OGLRenderer.hpp"
+#include "ImageIO.hpp"
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
-OGLRenderer::OGLRenderer(size_t width, size_t height) : needUpdate(true) {
+OGLRenderer::OGLRenderer(size_t width, size_t height, const SceneVariant &scene)
+    : needUpdate(true), windowWidth(width), windowHeight(height), lastFrameTime(0.0), fov(1.0f),
+      scene(&scene) {
   GLenum rev;
   glewExperimental = GL_TRUE;
   rev = glewInit();
@@ -13,7 +18,13 @@ OGLRenderer::OGLRenderer(size_t width, size_t height) : needUpdate(true) {
   }
 
   /********** OpenCL initialization **********/
-  oclRenderer.reset(new OCLRenderer(width, height, "raymarch", "kernels/kernels.cl"));
+  oclRenderer.reset(
+      new OCLRenderer(width, height, "raymarch", "kernels/kernels.cl", scene.buildOptions()));
+  oclRenderer->setSceneParams(scene.params);
+  for (const auto &variant : scenes::all())
+    oclRenderer->prepareProgram(variant.buildOptions());
+  oclRenderer->setConePrepass(true);
+  oclRenderer->setTemporalReprojection(true);
 
   /********** setup shader **********/
   renderShaderProgram.reset(new ShaderProgram("render"));
@@ -47,53 +58,227 @@ OGLRenderer::~OGLRenderer() {
 
 void OGLRenderer::reshape(int width, int height) {
   glViewport(0, 0, width, height);
-  if (oclRenderer != nullptr)
+  windowWidth = width;
+  windowHeight = height;
+  if (multiDeviceRenderer != nullptr)
+    multiDeviceRenderer->reshape(width, height);
+  else if (oclRenderer != nullptr)
     oclRenderer->reshape(width, height);
   refresh();
   display();
 }
 
 void OGLRenderer::display() {
-  oclRenderer->render(needUpdate);
+  renderScaleController.update(needUpdate, lastFrameTime);
+  const double scale = renderScaleController.getScale();
+  const size_t renderWidth = (size_t)std::round(scale * windowWidth);
+  const size_t renderHeight = (size_t)std::round(scale * windowHeight);
+  size_t samplesPerLaunch = 1;
+  double imageFraction = 1.0;
+  // the resolution is only lowered while the camera moves, where every frame starts a new pass
+  if (scale >= 1.0) {
+    frameTimeController.update(lastFrameTime);
+    samplesPerLaunch = frameTimeController.getSamplesPerLaunch();
+    imageFraction = frameTimeController.getImageFraction();
+  }
+  if (multiDeviceRenderer != nullptr) {
+    // the devices render their whole band with every frame, the bands are balanced instead
+    multiDeviceRenderer->setRenderSize(renderWidth, renderHeight);
+    multiDeviceRenderer->setSamplesPerLaunch(samplesPerLaunch);
+    multiDeviceRenderer->render(needUpdate);
+    mergeDeviceBands();
+  } else {
+    oclRenderer->setRenderSize(renderWidth, renderHeight);
+    oclRenderer->setSamplesPerLaunch(samplesPerLaunch);
+    oclRenderer->setRowsPerLaunch(
+        imageFraction < 1.0 ? (size_t)std::ceil(imageFraction * oclRenderer->getHeight()) : 0);
+    oclRenderer->render(needUpdate);
+  }
   needUpdate = false;
   renderShaderProgram->bind();
   renderShaderProgram->setUniform1i("srcTex", 0);
+  // the rendered image only covers the lower left corner of the texture
+  renderShaderProgram->setUniform2f("renderSize", oclRenderer->getWidth(),
+                                    oclRenderer->getHeight());
   glBindTexture(GL_TEXTURE_2D, oclRenderer->getTexture().id);
   glBindBuffer(GL_ARRAY_BUFFER, renderVbo);
   glBindVertexArray(renderVao);
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
+void OGLRenderer::mergeDeviceBands() {
+  const auto &renderers = multiDeviceRenderer->getRenderers();
+  glBindTexture(GL_TEXTURE_2D, oclRenderer->getTexture().id);
+  // the first renderer is the opencl renderer, which renders directly into the texture
+  for (size_t i = 1; i < renderers.size(); ++i) {
+    const size_t rows = renderers[i]->getRangeRows();
+    if (rows == 0)
+      continue;
+    const size_t firstRow = renderers[i]->getRangeBegin();
+    const std::vector<float> band = renderers[i]->getTargetRows(firstRow, rows);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, renderers[i]->getWidth(), rows, GL_RGBA,
+                    GL_FLOAT, band.data());
+  }
+}
+
+Renderer &OGLRenderer::getRenderer() {
+  if (multiDeviceRenderer != nullptr)
+    return *multiDeviceRenderer;
+  return *oclRenderer;
+}
+
+std::vector<std::shared_ptr<CLRenderer>> OGLRenderer::getDeviceRenderers() const {
+  if (multiDeviceRenderer != nullptr)
+    return multiDeviceRenderer->getRenderers();
+  return std::vector<std::shared_ptr<CLRenderer>>(1, oclRenderer);
+}
+
 void OGLRenderer::refresh() { needUpdate = true; }
 
 void OGLRenderer::setVMatrix(glm::mat4 m) {
-  oclRenderer->setVMatrix(m);
+  vMatrix = m;
+  getRenderer().setVMatrix(m);
   refresh();
 }
 
 void OGLRenderer::setFov(float fov) {
-  oclRenderer->setFov(fov);
+  this->fov = fov;
+  getRenderer().setFov(fov);
+  refresh();
+}
+
+void OGLRenderer::updateFrameTime(double frameTime) { lastFrameTime = frameTime; }
+
+void OGLRenderer::setTargetFrameTime(double targetFrameTime) {
+  frameTimeController.setTargetFrameTime(targetFrameTime);
+}
+
+double OGLRenderer::getTargetFrameTime() const { return frameTimeController.getTargetFrameTime(); }
+
+void OGLRenderer::toggleDynamicResolution() {
+  renderScaleController.setTargetFrameTime(renderScaleController.isEnabled() ? 0.0 : 1.0 / 30.0);
+}
+
+void OGLRenderer::toggleAdaptiveSampling() {
+  const bool enabled = !oclRenderer->getAdaptiveSampling();
+  for (auto &renderer : getDeviceRenderers())
+    renderer->setAdaptiveSampling(enabled);
+}
+
+void OGLRenderer::toggleWavefront() {
+  const bool enabled = !oclRenderer->getWavefront();
+  for (auto &renderer : getDeviceRenderers())
+    renderer->setWavefront(enabled);
+}
+
+void OGLRenderer::toggleConePrepass() {
+  const bool enabled = !oclRenderer->getConePrepass();
+  for (auto &renderer : getDeviceRenderers())
+    renderer->setConePrepass(enabled);
+}
+
+void OGLRenderer::toggleDistanceField() {
+  const size_t resolution =
+      oclRenderer->getDistanceField() > 0 ? 0 : DistanceField::DEFAULT_RESOLUTION;
+  for (auto &renderer : getDeviceRenderers())
+    renderer->setDistanceField(resolution);
+}
+
+void OGLRenderer::toggleTemporalReprojection() {
+  const bool enabled = !oclRenderer->getTemporalReprojection();
+  for (auto &renderer : getDeviceRenderers())
+    renderer->setTemporalReprojection(enabled);
+}
+
+void OGLRenderer::toggleMultiDevice() {
+  oclRenderer->finish();
+  if (multiDeviceRenderer != nullptr) {
+    // the other devices are released with the multi device renderer
+    multiDeviceRenderer.reset();
+    oclRenderer->setRowRange(0, std::numeric_limits<size_t>::max());
+    refresh();
+    return;
+  }
+  std::vector<std::shared_ptr<CLRenderer>> renderers(1, oclRenderer);
+  const auto devices = CLRenderer::getAllDevices();
+  for (size_t i = 0; i < devices.size(); ++i) {
+    if (devices[i]() == oclRenderer->getDevice()())
+      continue;
+    std::shared_ptr<CLRenderer> renderer(
+        new CLRenderer(windowWidth, windowHeight, "raymarch", "kernels/kernels.cl",
+                       scene->buildOptions(), i));
+    renderer->setSceneParams(scene->params);
+    renderer->setVMatrix(vMatrix);
+    renderer->setFov(fov);
+    renderer->setAdaptiveSampling(oclRenderer->getAdaptiveSampling());
+    renderer->setWavefront(oclRenderer->getWavefront());
+    renderer->setConePrepass(oclRenderer->getConePrepass());
+    renderer->setDistanceField(oclRenderer->getDistanceField());
+    renderer->setTemporalReprojection(oclRenderer->getTemporalReprojection());
+    std::cout << "[OGLRenderer] rendering additionally on "
+              << devices[i].getInfo<CL_DEVICE_NAME>() << std::endl;
+    renderers.push_back(renderer);
+  }
+  if (renderers.size() == 1) {
+    std::cerr << "[OGLRenderer] no other opencl devices available" << std::endl;
+    return;
+  }
+  multiDeviceRenderer.reset(new MultiDeviceRenderer(renderers));
   refresh();
 }
 
-size_t OGLRenderer::getSampleCount() { return oclRenderer->getSampleCount(); }
+void OGLRenderer::nextScene() {
+  const auto &variants = scenes::all();
+  scene = &variants[(scene - variants.data() + 1) % variants.size()];
+  // every renderer switches its program on its own as soon as the program is built
+  for (auto &renderer : getDeviceRenderers()) {
+    renderer->selectProgram(scene->buildOptions());
+    renderer->setSceneParams(scene->params);
+  }
+  std::cout << "[OGLRenderer] scene " << scene->name << std::endl;
+  refresh();
+}
+
+size_t OGLRenderer::getSampleCount() { return getRenderer().getSampleCount(); }
+
+void OGLRenderer::saveImage(const std::string &filename, bool hdr) {
+  bool submitted;
+  if (multiDeviceRenderer == nullptr) {
+    // the tonemapping and the readback run on the device, the encoding on the writer thread
+    auto image = oclRenderer->getImageAsync(hdr);
+    submitted = image != nullptr && imageWriter.submit(filename, image);
+  } else {
+    // the bands of the devices are merged on the host
+    const size_t width = multiDeviceRenderer->getWidth();
+    const size_t height = multiDeviceRenderer->getHeight();
+    if (hdr) {
+      auto pixels = std::make_shared<std::vector<float>>(multiDeviceRenderer->getRawImage());
+      submitted = imageWriter.submit([filename, width, height, pixels]() {
+        imageio::normalizeSamples(*pixels);
+        if (!imageio::writePFM(filename, width, height, *pixels))
+          std::cerr << "[OGLRenderer] could not write " << filename << std::endl;
+      });
+    } else {
+      auto pixels = std::make_shared<std::vector<uint8_t>>(multiDeviceRenderer->getImage());
+      submitted = imageWriter.submit([filename, width, height, pixels]() {
+        if (!imageio::writeBMP(filename, width, height, *pixels))
+          std::cerr << "[OGLRenderer] could not write " << filename << std::endl;
+      });
+    }
+  }
+  if (!submitted)
+    std::cerr << "[OGLRenderer] dropped " << filename << ", the previous images are still written"
+              << std::endl;
+}
 
 void OGLRenderer::saveRenderedImage(const std::string &filenamePrefix) {
-  glFinish();
-  size_t width = oclRenderer->getTexture().width;
-  size_t height = oclRenderer->getTexture().height;
-  uint32_t *pixels = new uint32_t[width * height];
-  auto rawImage = oclRenderer->getImage();
-
-  for (size_t i = 0; i < width * height * 4; i += 4)
-    pixels[i / 4] = (((uint32_t)rawImage[i + 0]) << 24) | (((uint32_t)rawImage[i + 1]) << 16) |
-                    (((uint32_t)rawImage[i + 2]) << 8) | (((uint32_t)rawImage[i + 3]) << 0);
-
-  SDL_Surface *image = SDL_CreateRGBSurfaceFrom(pixels, width, height, 24, 4 * width, 0xFF000000,
-                                                0x00FF0000, 0x0000FF00, 0x000000FF);
   std::ostringstream filename;
-  filename << filenamePrefix << time(nullptr) << "_" << oclRenderer->getSampleCount() << "SPP.bmp";
-  SDL_SaveBMP(image, filename.str().c_str());
-  SDL_FreeSurface(image);
-  delete[] pixels;
+  filename << filenamePrefix << time(nullptr) << "_" << getRenderer().getSampleCount() << "SPP.bmp";
+  saveImage(filename.str(), false);
+}
+
+void OGLRenderer::saveRenderedImageHDR(const std::string &filenamePrefix) {
+  std::ostringstream filename;
+  filename << filenamePrefix << time(nullptr) << "_" << getRenderer().getSampleCount() << "SPP.pfm";
+  saveImage(filename.str(), true);
 }
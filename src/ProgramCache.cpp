@@ -0,0 +1,142 @@
+#include "ProgramCache.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * creates the directory and all of its parents
+ */
+static bool createDirectories(const std::string &path) {
+  for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+    mkdir(path.substr(0, pos).c_str(), 0755);
+  mkdir(path.c_str(), 0755);
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool fileExists(const std::string &filename) {
+  struct stat info;
+  return stat(filename.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+ProgramCache::ProgramCache(const std::string &directory) : directory(directory) {}
+
+uint64_t ProgramCache::hash(const std::string &str) {
+  uint64_t retVal = 14695981039346656037ull;
+  for (unsigned char c : str) {
+    retVal ^= c;
+    retVal *= 1099511628211ull;
+  }
+  return retVal;
+}
+
+std::string ProgramCache::defaultDirectory() {
+  if (const char *dir = std::getenv("PATHMARCHCL_CACHE_DIR"))
+    return dir;
+  if (const char *dir = std::getenv("XDG_CACHE_HOME"))
+    return std::string(dir) + "/PathMarchCL";
+  if (const char *dir = std::getenv("HOME"))
+    return std::string(dir) + "/.cache/PathMarchCL";
+  return "";
+}
+
+std::string ProgramCache::readSource(const std::string &filename,
+                                     const std::vector<std::string> &includeDirs) {
+  std::ifstream sourcefile(filename);
+  if (!sourcefile.is_open()) {
+    std::cerr << "[ProgramCache] could not open " << filename << std::endl;
+    return "";
+  }
+  static const std::regex includeRegex("^\\s*#\\s*include\\s*\"([^\"]+)\".*");
+  const size_t slash = filename.find_last_of('/');
+  const std::string fileDir = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+
+  std::ostringstream source;
+  std::string line;
+  std::smatch match;
+  while (std::getline(sourcefile, line)) {
+    if (!std::regex_match(line, match, includeRegex)) {
+      source << line << "\n";
+      continue;
+    }
+    // search the included file relative to the current file first, then in the include dirs
+    std::string includeFilename = fileDir + match[1].str();
+    for (size_t i = 0; i < includeDirs.size() && !fileExists(includeFilename); ++i) {
+      const std::string &dir = includeDirs[i];
+      includeFilename = dir + (dir.empty() || dir.back() == '/' ? "" : "/") + match[1].str();
+    }
+    source << readSource(includeFilename, includeDirs);
+  }
+  return source.str();
+}
+
+std::string ProgramCache::cacheFilename(const cl::Device &device, const std::string &source,
+                                        const std::string &options) const {
+  cl::Platform platform(device.getInfo<CL_DEVICE_PLATFORM>());
+  std::ostringstream key;
+  key << source << '\0' << options << '\0' << device.getInfo<CL_DEVICE_NAME>() << '\0'
+      << device.getInfo<CL_DRIVER_VERSION>() << '\0' << platform.getInfo<CL_PLATFORM_VERSION>();
+  std::ostringstream filename;
+  filename << directory << "/" << std::hex << std::setw(16) << std::setfill('0')
+           << hash(key.str()) << ".bin";
+  return filename.str();
+}
+
+bool ProgramCache::load(const cl::Context &context, const cl::Device &device,
+                        const std::string &source, const std::string &options,
+                        cl::Program &program) const {
+  if (directory.empty())
+    return false;
+  std::ifstream file(cacheFilename(device, source, options), std::ios::binary);
+  if (!file.is_open())
+    return false;
+  std::string binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (binary.empty())
+    return false;
+
+  try {
+    std::vector<cl::Device> devices(1, device);
+    cl::Program::Binaries binaries(1, std::make_pair(binary.data(), binary.size()));
+    program = cl::Program(context, devices, binaries);
+    program.build(devices, options.c_str());
+  } catch (cl::Error error) {
+    // the binary is corrupt or not accepted by the driver, so it has to be rebuilt from source
+    return false;
+  }
+  return true;
+}
+
+void ProgramCache::store(const cl::Program &program, const cl::Device &device,
+                         const std::string &source, const std::string &options) const {
+  if (directory.empty() || !createDirectories(directory))
+    return;
+  // the program is only built for a single device
+  size_t binarySize = 0;
+  if (clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize,
+                       nullptr) != CL_SUCCESS ||
+      binarySize == 0)
+    return;
+  std::vector<unsigned char> binary(binarySize);
+  unsigned char *binaryPtr = binary.data();
+  if (clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(unsigned char *), &binaryPtr,
+                       nullptr) != CL_SUCCESS)
+    return;
+
+  // write to a temporary file first, so concurrent processes never read a partial binary
+  const std::string filename = cacheFilename(device, source, options);
+  const std::string tmpFilename = filename + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(tmpFilename, std::ios::binary);
+    if (!file.write((const char *)binary.data(), binary.size())) {
+      std::remove(tmpFilename.c_str());
+      return;
+    }
+  }
+  std::rename(tmpFilename.c_str(), filename.c_str());
+}
@@ -0,0 +1,55 @@
+#include "SceneParams.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static cl_float4 toFloat4(const glm::vec3 &v, float w = 0.0f) { return {{v.x, v.y, v.z, w}}; }
+
+cl_scene_params SceneParams::toCL() const {
+  cl_scene_params params;
+  // the bytes of the parameters key the cached distance fields, so the padding has to be zero too
+  std::memset(&params, 0, sizeof(params));
+  // the rotation about the axis (Rodrigues) scaled by 'kifsScale', the kernels multiply the point
+  // with the transposed matrix, so the offset ends up in the w components of the rows
+  const glm::vec3 axis = glm::normalize(kifsAxis);
+  const float angle = glm::radians(kifsAngle);
+  const float c = std::cos(angle);
+  const float s = std::sin(angle);
+  const glm::vec3 t = (1.0f - c) * axis;
+  const glm::vec3 rows[3] = {
+      glm::vec3(c + t.x * axis.x, t.y * axis.x - s * axis.z, t.z * axis.x + s * axis.y),
+      glm::vec3(t.x * axis.y + s * axis.z, c + t.y * axis.y, t.z * axis.y - s * axis.x),
+      glm::vec3(t.x * axis.z - s * axis.y, t.y * axis.z + s * axis.x, c + t.z * axis.z)};
+  for (int i = 0; i < 3; ++i)
+    params.kifsTransform[i] = {{kifsScale * rows[0][i], kifsScale * rows[1][i],
+                                kifsScale * rows[2][i], kifsOffset[i]}};
+  params.kifsTransform[3] = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  params.kifsInvScale = 1.0f / kifsScale;
+  params.kifsLodFactor = 1.0f / std::log2(kifsScale);
+  // an iteration maps a point at the distance r from the origin at least to the distance
+  // 'kifsScale' * r - c, where c is the length of the offset, which 'DEKIFS' weights with 0.3, so
+  // the distance of the points beyond c / ('kifsScale' - 1) + 1 stays above 1 in all iterations
+  // and they are outside of the fractal, scales up to 1 don't contract and get no bounds
+  const float offsetLength = 0.3f * glm::length(kifsOffset);
+  params.kifsBoundingRadius = kifsScale > 1.0f ? 1.01f * (offsetLength / (kifsScale - 1.0f) + 1.0f)
+                                               : std::numeric_limits<float>::infinity();
+  params.kifsIterations = kifsIterations;
+
+  params.light = toFloat4(light);
+  params.lightColor = toFloat4(lightColor);
+  params.matColor = toFloat4(matColor);
+  params.backgroundColor = toFloat4(backgroundColor);
+  params.shadowSoftness = shadowSoftness;
+  params.shadowMinLight = shadowMinLight;
+  params.footprintEpsilon = std::max(footprintEpsilon, 0.0f);
+  // the empty spheres of two points can't overlap anymore for factors near 2
+  params.relaxation = std::min(std::max(relaxation, 1.0f), 1.9f);
+
+  params.mengerOffset = toFloat4(mengerOffset);
+  params.mengerScale = mengerScale;
+  params.mengerInvScale = 1.0f / mengerScale;
+  params.mengerLodFactor = 1.0f / std::log2(mengerScale);
+  params.mengerIterations = mengerIterations;
+  return params;
+}
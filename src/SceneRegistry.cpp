@@ -0,0 +1,43 @@
+#include "SceneRegistry.hpp"
+#include <iomanip>
+#include <sstream>
+
+std::string SceneVariant::buildOptions() const {
+  std::ostringstream options;
+  // all digits, so the baked precision is exactly the float of the registry
+  options << std::setprecision(9) << "-D " << define << " -D MAX_RAYMARCH_STEPS="
+          << maxRaymarchSteps << " -D RAYMARCH_PRECISION=" << raymarchPrecision
+          << "f -D SCENE_SHADOWS=" << shadows << " -D SCENE_AO=" << ao;
+  return options.str();
+}
+
+/**
+ * returns the default parameters with the tolerance and the relaxation of the march of a scene
+ */
+static SceneParams marchParams(float footprintEpsilon, float relaxation) {
+  SceneParams params;
+  params.footprintEpsilon = footprintEpsilon;
+  params.relaxation = relaxation;
+  return params;
+}
+
+namespace scenes {
+const std::vector<SceneVariant> &all() {
+  // the sponge is shaded by the count of march steps only, so it needs neither shadows nor AO, but
+  // relaxed steps and the tolerance of the footprint would lower the count and brighten it, so it
+  // keeps the plain steps and the fixed precision, the fine detail of the kaleido fractal keeps a
+  // tolerance of half the footprint
+  static const std::vector<SceneVariant> variants = {
+      {"menger", "SCENE_MENGER", 1500, 0.000001f, false, false, marchParams(0.0f, 1.0f)},
+      {"kaleido", "SCENE_KALEIDO", 250, 0.0000001f, true, true, marchParams(0.5f, 1.2f)},
+  };
+  return variants;
+}
+
+const SceneVariant *find(const std::string &name) {
+  for (const auto &variant : all())
+    if (variant.name == name)
+      return &variant;
+  return nullptr;
+}
+} // namespace scenes
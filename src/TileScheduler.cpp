@@ -0,0 +1,83 @@
+#include "TileScheduler.hpp"
+#include <algorithm>
+
+TileScheduler::TileScheduler(size_t threadCount) : generation(0), activeWorkers(0), quit(false) {
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < threadCount; ++i)
+    queues.emplace_back(new WorkerQueue());
+  for (size_t i = 0; i < threadCount; ++i)
+    threads.emplace_back(&TileScheduler::workerLoop, this, i);
+}
+
+TileScheduler::~TileScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  startCondition.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+size_t TileScheduler::getThreadCount() const { return threads.size(); }
+
+bool TileScheduler::popTile(size_t worker, size_t &tile) {
+  {
+    WorkerQueue &own = *queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tiles.empty()) {
+      tile = own.tiles.front();
+      own.tiles.pop_front();
+      return true;
+    }
+  }
+  // steal from the back of the other queues, which is the farthest away from their current work
+  for (size_t i = 1; i < queues.size(); ++i) {
+    WorkerQueue &victim = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tiles.empty()) {
+      tile = victim.tiles.back();
+      victim.tiles.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TileScheduler::workerLoop(size_t worker) {
+  size_t lastGeneration = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      startCondition.wait(lock, [&] { return quit || generation != lastGeneration; });
+      if (quit)
+        return;
+      lastGeneration = generation;
+    }
+    size_t tile;
+    while (popTile(worker, tile))
+      task(tile);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --activeWorkers;
+    }
+    doneCondition.notify_one();
+  }
+}
+
+void TileScheduler::run(size_t tileCount, const std::function<void(size_t)> &task) {
+  const size_t workerCount = queues.size();
+  for (size_t i = 0; i < workerCount; ++i) {
+    std::lock_guard<std::mutex> lock(queues[i]->mutex);
+    for (size_t tile = i * tileCount / workerCount; tile < (i + 1) * tileCount / workerCount;
+         ++tile)
+      queues[i]->tiles.push_back(tile);
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  this->task = task;
+  activeWorkers = workerCount;
+  ++generation;
+  startCondition.notify_all();
+  doneCondition.wait(lock, [&] { return activeWorkers == 0; });
+}
@@ -0,0 +1,69 @@
+#include "TiledRenderer.hpp"
+#include <algorithm>
+#include <thread>
+
+TiledRenderer::TiledRenderer(size_t width, size_t height, size_t tileSize,
+                             const std::string &kernelname, const std::string &sourceFilename,
+                             const std::string &buildOptions, size_t deviceIndex)
+    : renderer(new CLRenderer(std::min(tileSize, width), std::min(tileSize, height), kernelname,
+                              sourceFilename, buildOptions, deviceIndex)),
+      width(width), height(height), tileSize(tileSize), vMatrix(1.0f), fov(1.0f) {}
+
+void TiledRenderer::setTileView(size_t x, size_t y, size_t tileWidth, size_t tileHeight) {
+  // see 'generateCameraRay' in kernels/common.cl: the image plane of the tile is the image plane
+  // of the whole image scaled by 'tileWidth / width' and moved by an offset, the scale is applied
+  // to the fov and the offset with a shear of the view frustum
+  const float tileFov = fov * width / tileWidth;
+  const float offsetU = (2.0f * x - width) / tileWidth + 1.0f;
+  const float offsetV = (2.0f * y + tileHeight - height) / tileWidth;
+  glm::mat4 shear(1.0f);
+  shear[2][0] = -offsetU / tileFov;
+  shear[2][1] = -offsetV / tileFov;
+  renderer->setVMatrix(vMatrix * shear);
+  renderer->setFov(tileFov);
+}
+
+void TiledRenderer::render(imageio::MappedImage &image, size_t samplesPerPixel,
+                           size_t samplesPerLaunch) {
+  const size_t tilesX = (width + tileSize - 1) / tileSize;
+  const size_t tilesY = (height + tileSize - 1) / tileSize;
+  // one tile is rendered while the previous one is written
+  PendingTile pending[2];
+  std::thread writer;
+  for (size_t tile = 0; tile < tilesX * tilesY; ++tile) {
+    PendingTile &current = pending[tile % 2];
+    current.x = (tile % tilesX) * tileSize;
+    current.y = (tile / tilesX) * tileSize;
+    current.width = std::min(tileSize, width - current.x);
+    current.height = std::min(tileSize, height - current.y);
+    renderer->setRenderSize(current.width, current.height);
+    setTileView(current.x, current.y, current.width, current.height);
+    // otherwise the noise would repeat with every tile
+    renderer->setRandSeed(tile * tileSize * tileSize);
+    for (size_t spp = 0; spp < samplesPerPixel; spp += samplesPerLaunch) {
+      renderer->setSamplesPerLaunch(std::min(samplesPerLaunch, samplesPerPixel - spp));
+      renderer->render(spp == 0);
+    }
+    current.read = renderer->getRawImageAsync(current.pixels);
+
+    // the other slot is free for the next tile as soon as the previous tile is written
+    if (writer.joinable())
+      writer.join();
+    writer = std::thread([this, &image, &current]() {
+      current.read.wait();
+      image.writeTile(current.x, current.y, current.width, current.height,
+                      current.pixels.data());
+      // the rows of a row of tiles are complete with its last tile
+      if (current.x + current.width == width)
+        image.releaseRows(current.y, current.height);
+    });
+  }
+  if (writer.joinable())
+    writer.join();
+}
+
+void TiledRenderer::setVMatrix(glm::mat4 m) { vMatrix = m; }
+
+void TiledRenderer::setFov(float fov) { this->fov = fov; }
+
+CLRenderer &TiledRenderer::getTileRenderer() { return *renderer; }
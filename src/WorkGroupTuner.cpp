@@ -0,0 +1,182 @@
+#include "WorkGroupTuner.hpp"
+#include "CLUtils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the candidates in the order of the launches while tuning
+static const size_t CANDIDATES[][2] = {{8, 8},  {16, 4}, {32, 2}, {64, 1}, {4, 8},   {8, 4},
+                                       {16, 2}, {32, 1}, {16, 8}, {32, 4}, {64, 2}, {32, 8},
+                                       {64, 4}, {16, 16}, {32, 16}};
+
+WorkGroupTuner::WorkGroupTuner(const cl::Kernel &kernel, const cl::Device &device,
+                               uint64_t programHash, size_t maxHeight,
+                               const std::string &directory)
+    : passCount(0), current(0), currentItems(0), timedPass(0), timedNanoseconds(0.0),
+      timedItems(0), timedDiscarded(false), tuned(false) {
+  const size_t maxGroupSize = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+  const std::vector<size_t> maxItemSizes = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+  for (const auto &candidate : CANDIDATES) {
+    if (candidate[0] * candidate[1] > maxGroupSize || candidate[0] > maxItemSizes[0] ||
+        candidate[1] > maxItemSizes[1] || candidate[1] > maxHeight)
+      continue;
+    cl::size_t<2> size;
+    size[0] = candidate[0];
+    size[1] = candidate[1];
+    candidates.push_back(size);
+  }
+  // e.g. a kernel with a lot of registers on a small device, there is nothing to tune then
+  if (candidates.empty()) {
+    cl::size_t<2> size;
+    size[0] = 1;
+    size[1] = 1;
+    candidates.push_back(size);
+    tuned = true;
+  }
+  times.resize(candidates.size());
+
+  cl::Platform platform(device.getInfo<CL_DEVICE_PLATFORM>());
+  std::ostringstream keySource;
+  keySource << programHash << '\0' << kernel.getInfo<CL_KERNEL_FUNCTION_NAME>() << '\0'
+            << device.getInfo<CL_DEVICE_NAME>() << '\0' << device.getInfo<CL_DRIVER_VERSION>()
+            << '\0' << platform.getInfo<CL_PLATFORM_VERSION>() << '\0' << maxHeight;
+  std::ostringstream keyHex;
+  keyHex << std::hex << std::setw(16) << std::setfill('0') << ProgramCache::hash(keySource.str());
+  key = keyHex.str();
+  if (!directory.empty())
+    tableFilename = directory + "/workgroups.txt";
+  if (!tuned)
+    tuned = loadWinner();
+}
+
+bool WorkGroupTuner::loadWinner() {
+  std::ifstream table(tableFilename);
+  std::string line;
+  while (std::getline(table, line)) {
+    std::istringstream in(line);
+    std::string lineKey;
+    size_t x, y;
+    if (!(in >> lineKey >> x >> y) || lineKey != key)
+      continue;
+    // the table may be older than the candidates or come from another version of the driver
+    for (size_t i = 0; i < candidates.size(); ++i)
+      if (candidates[i][0] == x && candidates[i][1] == y) {
+        current = i;
+        return true;
+      }
+  }
+  return false;
+}
+
+void WorkGroupTuner::storeWinner() const {
+  if (tableFilename.empty())
+    return;
+  // creates the cache directory and its parents, see 'ProgramCache::store'
+  for (size_t pos = tableFilename.find('/', 1); pos != std::string::npos;
+       pos = tableFilename.find('/', pos + 1))
+    mkdir(tableFilename.substr(0, pos).c_str(), 0755);
+  // the other entries are kept, an older entry of this kernel is replaced
+  std::ostringstream content;
+  {
+    std::ifstream table(tableFilename);
+    std::string line;
+    while (std::getline(table, line))
+      if (line.compare(0, key.size() + 1, key + " ") != 0)
+        content << line << "\n";
+  }
+  content << key << " " << candidates[current][0] << " " << candidates[current][1] << "\n";
+  // write to a temporary file first, so concurrent processes never read a partial table
+  const std::string tmpFilename = tableFilename + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream table(tmpFilename);
+    if (!(table << content.str())) {
+      std::remove(tmpFilename.c_str());
+      return;
+    }
+  }
+  std::rename(tmpFilename.c_str(), tableFilename.c_str());
+}
+
+void WorkGroupTuner::finishTimedPass(size_t pass) {
+  if (timedItems > 0 && !timedDiscarded)
+    times[timedPass % candidates.size()].push_back(timedNanoseconds / timedItems);
+  timedPass = pass;
+  timedNanoseconds = 0.0;
+  timedItems = 0;
+  timedDiscarded = false;
+}
+
+void WorkGroupTuner::collectTimes() {
+  // a pass is complete as soon as a launch of a later pass is complete
+  while (!pending.empty() &&
+         pending.front().event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() == CL_COMPLETE) {
+    const PendingLaunch &launch = pending.front();
+    if (launch.pass != timedPass)
+      finishTimedPass(launch.pass);
+    const cl_ulong start = launch.event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    const cl_ulong end = launch.event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    timedNanoseconds += (double)(end - start);
+    timedItems += launch.items;
+    timedDiscarded = timedDiscarded || launch.discarded;
+    pending.pop_front();
+  }
+  for (const auto &candidateTimes : times)
+    if (candidateTimes.size() < PASSES_PER_CANDIDATE)
+      return;
+
+  // the median, so a launch which was interrupted by another process doesn't decide
+  double bestTime = 0.0;
+  for (size_t i = 0; i < times.size(); ++i) {
+    std::vector<double> sorted = times[i];
+    std::sort(sorted.begin(), sorted.end());
+    const double time = sorted[sorted.size() / 2];
+    if (i == 0 || time < bestTime) {
+      bestTime = time;
+      current = i;
+    }
+  }
+  tuned = true;
+  pending.clear();
+  storeWinner();
+}
+
+void WorkGroupTuner::beginPass(bool previousComplete) {
+  if (tuned)
+    return;
+  if (!previousComplete) {
+    for (auto &launch : pending)
+      if (launch.pass == passCount)
+        launch.discarded = true;
+    if (timedPass == passCount)
+      timedDiscarded = true;
+  }
+  // the candidates take turns per pass, so all of them are timed on the same rows
+  current = ++passCount % candidates.size();
+}
+
+cl::EnqueueArgs WorkGroupTuner::launchArgs(cl::CommandQueue &queue, const cl::NDRange &offset,
+                                           size_t width, size_t height) {
+  if (!tuned)
+    collectTimes();
+  currentItems = width * height;
+  const size_t localX = candidates[current][0];
+  const size_t localY = candidates[current][1];
+  return cl::EnqueueArgs(queue, offset,
+                         cl::NDRange(cl::nextDivisible(width, localX),
+                                     cl::nextDivisible(height, localY)),
+                         cl::NDRange(localX, localY));
+}
+
+void WorkGroupTuner::addLaunch(const cl::Event &launch) {
+  if (tuned)
+    return;
+  pending.push_back({passCount, currentItems, false, launch});
+}
+
+bool WorkGroupTuner::isTuned() const { return tuned; }
+
+cl::size_t<2> WorkGroupTuner::getLocalSize() const { return candidates[current]; }
@@ -0,0 +1,393 @@
+#include "CLRenderer.hpp"
+#include "CLUtils.hpp"
+#include "CPURenderer.hpp"
+#include "Camera.hpp"
+#include "ImageIO.hpp"
+#include "ImageWriter.hpp"
+#include "MultiDeviceRenderer.hpp"
+#include "SceneRegistry.hpp"
+#include "TiledRenderer.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#define PROGRAM_NAME "PathMarchCLHeadless"
+
+/**
+ * command line options of the offline renderer
+ */
+struct Options {
+  size_t width = 1280;
+  size_t height = 720;
+  size_t spp = 64;
+  size_t sppPerLaunch = 1;
+  size_t deviceIndex = 0;
+  size_t threadCount = 0;
+  size_t tileSize = 0; // 0 renders the whole image at once
+  double checkpointInterval = 600.0; // in seconds
+  double snapshotInterval = 0.0;     // in seconds, 0 disables the snapshots
+  float fov = 2.0f;
+  float adaptiveThreshold = 0.0f; // 0 disables adaptive sampling
+  size_t minSpp = 16;
+  size_t distanceField = 0; // the resolution of the baked distance field, 0 disables it
+  glm::vec3 position = glm::vec3(0.0f, 0.0f, -1.0f);
+  glm::vec3 rotation = glm::vec3(0.0f); // pitch, yaw and roll in radians
+  std::string scene = "menger";
+  std::string sampler = "random";
+  std::string normals; // empty uses the estimator of the scene
+  std::string backend = "opencl";
+  std::string output = "render.ppm";
+  std::string checkpoint; // empty disables the checkpoints
+  bool listDevices = false;
+  bool wavefront = false;
+  bool conePrepass = false;
+  bool multiDevice = false;
+  bool resume = false;
+};
+
+static void printUsage() {
+  std::cout
+      << "usage: " << PROGRAM_NAME << " [options]\n"
+      << "  --width <pixels>          width of the rendered image (default 1280)\n"
+      << "  --height <pixels>         height of the rendered image (default 720)\n"
+      << "  --spp <count>             samples per pixel (default 64)\n"
+      << "  --spp-per-launch <count>  samples per pixel rendered with one launch (default 1)\n"
+      << "  --fov <value>             field of view, larger values mean a smaller FOV (default 2)\n"
+      << "  --position <x,y,z>        camera position (default 0,0,-1)\n"
+      << "  --rotation <p,y,r>        camera pitch, yaw and roll in radians (default 0,0,0)\n"
+      << "  --scene <menger|kaleido>  the scene to render (default menger)\n"
+      << "  --sampler <name>          random, sobol, r2 or bluenoise, the low discrepancy\n"
+      << "                            samplers converge faster (default random, opencl only)\n"
+      << "  --normals <name>          central, tetrahedral or dual, the estimator of the surface\n"
+      << "                            normals (default: the one of the scene, opencl only)\n"
+      << "  --adaptive-threshold <e>  stop sampling pixels with a relative error below e, 0\n"
+      << "                            samples all pixels (default 0, opencl backend only)\n"
+      << "  --min-spp <count>         samples per pixel before pixels may converge (default 16)\n"
+      << "  --wavefront               render with one opencl kernel per stage\n"
+      << "  --cone-prepass            start the camera rays from the distances of a cone prepass\n"
+      << "  --distance-field <cells>  march far from the surface through a distance field with\n"
+      << "                            cells^3 cells, which is baked once and cached (default 0\n"
+      << "                            disables it, opencl only)\n"
+      << "  --backend <opencl|cpu>    render with opencl or natively on the host (default opencl)\n"
+      << "  --device <index>          index of the opencl device (default 0)\n"
+      << "  --multi-device            split the image into bands over all opencl devices\n"
+      << "  --tile-size <pixels>      render tiles of this size one after the other directly into\n"
+      << "                            the output file, for images larger than the device memory\n"
+      << "                            (no checkpoints or snapshots)\n"
+      << "  --threads <count>         count of threads of the cpu backend (default all cores)\n"
+      << "  --checkpoint <file>       save the accumulated image periodically to this file\n"
+      << "  --checkpoint-interval <s> seconds between two checkpoints (default 600)\n"
+      << "  --resume                  continue the accumulation of the checkpoint file\n"
+      << "  --snapshot-interval <s>   write the output file every s seconds while rendering\n"
+      << "                            (default 0 disables it, single opencl device only)\n"
+      << "  --list-devices            list all available opencl devices and exit\n"
+      << "  --output <file>           output file, .pfm for HDR, .ppm otherwise (default "
+         "render.ppm)\n";
+}
+
+static bool parseVec3(const char *str, glm::vec3 &v) {
+  char c1, c2;
+  std::istringstream in(str);
+  return (in >> v.x >> c1 >> v.y >> c2 >> v.z) && c1 == ',' && c2 == ',';
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--list-devices") {
+      options.listDevices = true;
+      continue;
+    }
+    if (arg == "--wavefront") {
+      options.wavefront = true;
+      continue;
+    }
+    if (arg == "--cone-prepass") {
+      options.conePrepass = true;
+      continue;
+    }
+    if (arg == "--multi-device") {
+      options.multiDevice = true;
+      continue;
+    }
+    if (arg == "--resume") {
+      options.resume = true;
+      continue;
+    }
+    if (arg == "--help" || i + 1 >= argc)
+      return false;
+    const char *value = argv[++i];
+    if (arg == "--width")
+      options.width = std::strtoul(value, nullptr, 10);
+    else if (arg == "--height")
+      options.height = std::strtoul(value, nullptr, 10);
+    else if (arg == "--spp")
+      options.spp = std::strtoul(value, nullptr, 10);
+    else if (arg == "--spp-per-launch")
+      options.sppPerLaunch = std::strtoul(value, nullptr, 10);
+    else if (arg == "--device")
+      options.deviceIndex = std::strtoul(value, nullptr, 10);
+    else if (arg == "--threads")
+      options.threadCount = std::strtoul(value, nullptr, 10);
+    else if (arg == "--tile-size")
+      options.tileSize = std::strtoul(value, nullptr, 10);
+    else if (arg == "--min-spp")
+      options.minSpp = std::strtoul(value, nullptr, 10);
+    else if (arg == "--distance-field")
+      options.distanceField = std::strtoul(value, nullptr, 10);
+    else if (arg == "--adaptive-threshold")
+      options.adaptiveThreshold = std::strtof(value, nullptr);
+    else if (arg == "--fov")
+      options.fov = std::strtof(value, nullptr);
+    else if (arg == "--checkpoint-interval")
+      options.checkpointInterval = std::strtod(value, nullptr);
+    else if (arg == "--snapshot-interval")
+      options.snapshotInterval = std::strtod(value, nullptr);
+    else if (arg == "--checkpoint")
+      options.checkpoint = value;
+    else if (arg == "--scene")
+      options.scene = value;
+    else if (arg == "--sampler")
+      options.sampler = value;
+    else if (arg == "--normals")
+      options.normals = value;
+    else if (arg == "--backend")
+      options.backend = value;
+    else if (arg == "--output")
+      options.output = value;
+    else if (arg == "--position") {
+      if (!parseVec3(value, options.position))
+        return false;
+    } else if (arg == "--rotation") {
+      if (!parseVec3(value, options.rotation))
+        return false;
+    } else
+      return false;
+  }
+  return options.width > 0 && options.height > 0 && options.spp > 0 && options.sppPerLaunch > 0 &&
+         scenes::find(options.scene) != nullptr &&
+         (options.sampler == "random" || options.sampler == "sobol" || options.sampler == "r2" ||
+          options.sampler == "bluenoise") &&
+         (options.normals.empty() || options.normals == "central" ||
+          options.normals == "tetrahedral" || options.normals == "dual") &&
+         (options.backend == "opencl" || options.backend == "cpu");
+}
+
+/**
+ * renders the image tile by tile directly into the memory mapped output file
+ */
+static int renderTiled(const Options &options, const Camera &camera,
+                       const std::string &buildOptions) {
+  TiledRenderer renderer(options.width, options.height, options.tileSize, "raymarch",
+                         "kernels/kernels.cl", buildOptions, options.deviceIndex);
+  CLRenderer &tileRenderer = renderer.getTileRenderer();
+  const SceneVariant &scene = *scenes::find(options.scene);
+  tileRenderer.setSceneParams(scene.params);
+  tileRenderer.setWavefront(options.wavefront);
+  tileRenderer.setDistanceField(options.distanceField);
+  if (options.adaptiveThreshold > 0.0f)
+    tileRenderer.setAdaptiveSampling(true, options.adaptiveThreshold, options.minSpp);
+  std::cout << "[" << PROGRAM_NAME << "] rendering " << options.tileSize << "x"
+            << options.tileSize << " tiles on "
+            << tileRenderer.getDevice().getInfo<CL_DEVICE_NAME>() << std::endl;
+  renderer.setVMatrix(camera.getViewMatrix());
+  renderer.setFov(options.fov);
+
+  imageio::MappedImage image(options.output, options.width, options.height,
+                             imageio::hasExtension(options.output, ".pfm")
+                                 ? imageio::MappedImage::PFM
+                                 : imageio::MappedImage::PPM);
+  if (!image.isOpen()) {
+    std::cerr << "[" << PROGRAM_NAME << "] could not create " << options.output << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto startTime = Clock::now();
+  renderer.render(image, options.spp, options.sppPerLaunch);
+  const double elapsedTime = (double)getPastTime(startTime) / 1.0e9;
+  std::cout << "[" << PROGRAM_NAME << "] " << options.spp << " spp in " << elapsedTime << " s, "
+            << (double)options.width * options.height * options.spp / elapsedTime / 1.0e6
+            << " MSamples/s" << std::endl;
+  if (!image.close()) {
+    std::cerr << "[" << PROGRAM_NAME << "] could not write " << options.output << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  if (options.listDevices) {
+    auto devices = CLRenderer::getAllDevices();
+    for (size_t i = 0; i < devices.size(); ++i)
+      std::cout << i << ": " << devices[i].getInfo<CL_DEVICE_NAME>() << " ("
+                << cl::deviceTypeString(devices[i].getInfo<CL_DEVICE_TYPE>()) << ")" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  Camera camera(options.position);
+  camera.pitch(options.rotation.x);
+  camera.yaw(options.rotation.y);
+  camera.roll(options.rotation.z);
+  // the program is specialized for the scene, see SceneVariant
+  const SceneVariant &scene = *scenes::find(options.scene);
+  std::string buildOptions = scene.buildOptions();
+  if (options.sampler == "sobol")
+    buildOptions += " -D SAMPLER_SOBOL";
+  else if (options.sampler == "r2")
+    buildOptions += " -D SAMPLER_R2";
+  else if (options.sampler == "bluenoise")
+    buildOptions += " -D SAMPLER_BLUE_NOISE";
+  if (options.normals == "central")
+    buildOptions += " -D NORMAL_ESTIMATOR=NORMAL_CENTRAL";
+  else if (options.normals == "tetrahedral")
+    buildOptions += " -D NORMAL_ESTIMATOR=NORMAL_TETRAHEDRAL";
+  else if (options.normals == "dual")
+    buildOptions += " -D NORMAL_ESTIMATOR=NORMAL_DUAL";
+
+  if (options.tileSize > 0) {
+    if (options.backend != "opencl" || options.multiDevice || options.conePrepass) {
+      std::cerr << "[" << PROGRAM_NAME << "] --tile-size only works with a single opencl device "
+                << "and without the cone prepass" << std::endl;
+      return EXIT_FAILURE;
+    }
+    // the tiles are written directly into the output file, there is no accumulation of the whole
+    // image to checkpoint or to snapshot
+    if (!options.checkpoint.empty() || options.resume || options.snapshotInterval > 0.0) {
+      std::cerr << "[" << PROGRAM_NAME << "] --tile-size doesn't work with checkpoints or "
+                << "snapshots" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return renderTiled(options, camera, buildOptions);
+  }
+  if ((!options.checkpoint.empty() || options.resume) &&
+      (options.backend != "opencl" || options.multiDevice)) {
+    std::cerr << "[" << PROGRAM_NAME << "] checkpoints only work with a single opencl device"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (options.snapshotInterval > 0.0 && (options.backend != "opencl" || options.multiDevice)) {
+    std::cerr << "[" << PROGRAM_NAME << "] snapshots only work with a single opencl device"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<Renderer> renderer;
+  // the renderer whose accumulation is checkpointed and read back for the snapshots
+  CLRenderer *checkpointRenderer = nullptr;
+  if (options.backend == "cpu") {
+    auto cpuRenderer = new CPURenderer(
+        options.width, options.height,
+        options.scene == "kaleido" ? CPURenderer::KALEIDO : CPURenderer::MENGER,
+        options.threadCount);
+    renderer.reset(cpuRenderer);
+    std::cout << "[" << PROGRAM_NAME << "] rendering on the host with "
+              << cpuRenderer->getThreadCount() << " threads" << std::endl;
+  } else if (options.multiDevice) {
+    auto multiDeviceRenderer = new MultiDeviceRenderer(options.width, options.height, "raymarch",
+                                                       "kernels/kernels.cl", buildOptions);
+    renderer.reset(multiDeviceRenderer);
+    multiDeviceRenderer->setSceneParams(scene.params);
+    for (auto &clRenderer : multiDeviceRenderer->getRenderers()) {
+      clRenderer->setWavefront(options.wavefront);
+      clRenderer->setConePrepass(options.conePrepass);
+      clRenderer->setDistanceField(options.distanceField);
+      if (options.adaptiveThreshold > 0.0f)
+        clRenderer->setAdaptiveSampling(true, options.adaptiveThreshold, options.minSpp);
+      std::cout << "[" << PROGRAM_NAME << "] rendering on "
+                << clRenderer->getDevice().getInfo<CL_DEVICE_NAME>() << std::endl;
+    }
+  } else {
+    auto clRenderer = new CLRenderer(options.width, options.height, "raymarch",
+                                     "kernels/kernels.cl", buildOptions, options.deviceIndex);
+    renderer.reset(clRenderer);
+    checkpointRenderer = clRenderer;
+    clRenderer->setSceneParams(scene.params);
+    clRenderer->setWavefront(options.wavefront);
+    clRenderer->setConePrepass(options.conePrepass);
+    clRenderer->setDistanceField(options.distanceField);
+    if (options.adaptiveThreshold > 0.0f)
+      clRenderer->setAdaptiveSampling(true, options.adaptiveThreshold, options.minSpp);
+    std::cout << "[" << PROGRAM_NAME << "] rendering on "
+              << clRenderer->getDevice().getInfo<CL_DEVICE_NAME>() << std::endl;
+  }
+
+  renderer->setVMatrix(camera.getViewMatrix());
+  renderer->setFov(options.fov);
+
+  // the checkpoint also restores the view it was rendered with
+  size_t firstSpp = 0;
+  if (options.resume) {
+    if (checkpointRenderer->loadCheckpoint(options.checkpoint)) {
+      firstSpp = checkpointRenderer->getSampleCount();
+      std::cout << "[" << PROGRAM_NAME << "] resuming " << options.checkpoint << " at " << firstSpp
+                << " spp" << std::endl;
+    } else
+      std::cout << "[" << PROGRAM_NAME << "] no checkpoint to resume, starting from scratch"
+                << std::endl;
+  }
+
+  // the snapshots are read back and written without stalling the render loop, the writer is
+  // destroyed after the loop, so no snapshot overwrites the final image
+  const bool hdrOutput = imageio::hasExtension(options.output, ".pfm");
+  std::unique_ptr<ImageWriter> snapshotWriter;
+  if (options.snapshotInterval > 0.0)
+    snapshotWriter.reset(new ImageWriter(1));
+
+  auto startTime = Clock::now();
+  auto checkpointTime = startTime;
+  auto snapshotTime = startTime;
+  for (size_t spp = firstSpp; spp < options.spp; spp += options.sppPerLaunch) {
+    renderer->setSamplesPerLaunch(std::min(options.sppPerLaunch, options.spp - spp));
+    renderer->render(spp == 0);
+    if (!options.checkpoint.empty() &&
+        (double)getPastTime(checkpointTime) / 1.0e9 >= options.checkpointInterval) {
+      if (!checkpointRenderer->saveCheckpoint(options.checkpoint))
+        std::cerr << "[" << PROGRAM_NAME << "] could not write " << options.checkpoint
+                  << std::endl;
+      checkpointTime = Clock::now();
+    }
+    if (snapshotWriter != nullptr &&
+        (double)getPastTime(snapshotTime) / 1.0e9 >= options.snapshotInterval) {
+      // a snapshot is skipped if the previous one is still written
+      auto image = checkpointRenderer->getImageAsync(hdrOutput);
+      if (image != nullptr)
+        snapshotWriter->submit(options.output, image);
+      snapshotTime = Clock::now();
+    }
+  }
+  snapshotWriter.reset();
+  renderer->finish();
+  const double elapsedTime = (double)getPastTime(startTime) / 1.0e9;
+  const size_t renderedSpp = options.spp - std::min(firstSpp, options.spp);
+  std::cout << "[" << PROGRAM_NAME << "] " << renderedSpp << " spp in " << elapsedTime << " s, "
+            << (double)options.width * options.height * renderedSpp / elapsedTime / 1.0e6
+            << " MSamples/s" << std::endl;
+  // the final checkpoint allows to continue with more samples per pixel later
+  if (!options.checkpoint.empty() && !checkpointRenderer->saveCheckpoint(options.checkpoint))
+    std::cerr << "[" << PROGRAM_NAME << "] could not write " << options.checkpoint << std::endl;
+
+  bool written;
+  if (hdrOutput) {
+    // the pixels may have different counts of samples, e.g. with adaptive sampling
+    auto image = renderer->getRawImage();
+    imageio::normalizeSamples(image);
+    written = imageio::writePFM(options.output, options.width, options.height, image);
+  }
+  else
+    written =
+        imageio::writePPM(options.output, options.width, options.height, renderer->getImage());
+  if (!written) {
+    std::cerr << "[" << PROGRAM_NAME << "] could not write " << options.output << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
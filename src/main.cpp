@@ -1,7 +1,9 @@
 #include "App.hpp"
+#include "SceneRegistry.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #define PROGRAM_NAME "PathMarchCL"
@@ -10,8 +12,28 @@ const size_t WIDTH = 1280;
 const size_t HEIGHT = 720;
 
 int main(int argc, char *argv[]) {
-  // disable cuda cache because it doesn't recompile the opencl kernels otherwise for some reason
+  // disable cuda cache because it doesn't recompile the opencl kernels otherwise for some reason,
+  // the compiled programs are cached by 'ProgramCache' instead, which also tracks included files
   setenv("CUDA_CACHE_DISABLE", "1", 1);
+
+  // the scene can be switched later with the key 'k'
+  const SceneVariant *scene = &scenes::all().front();
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+      scene = scenes::find(argv[++i]);
+      if (scene == nullptr) {
+        std::cerr << "unknown scene " << argv[i] << ", the scenes are:";
+        for (const auto &variant : scenes::all())
+          std::cerr << " " << variant.name;
+        std::cerr << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--scene <name>]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   SDL_Window *mainwindow;
   SDL_GLContext maincontext;
 
@@ -46,7 +68,7 @@ int main(int argc, char *argv[]) {
   // enable mouse catching
   SDL_SetRelativeMouseMode(SDL_TRUE);
 
-  auto app = std::make_shared<App>(mainwindow);
+  auto app = std::make_shared<App>(mainwindow, *scene);
   // the main loop
   app->mainLoop();
 